@@ -0,0 +1,168 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <algorithm>
+#include <string.h>
+#include "aiffscrubber.h"
+
+#define AIFFSCRUBBER_COMM PCMFILESCRUBBER_ID('C', 'O', 'M', 'M')
+#define AIFFSCRUBBER_FVER PCMFILESCRUBBER_ID('F', 'V', 'E', 'R')
+#define AIFFSCRUBBER_SSND PCMFILESCRUBBER_ID('S', 'S', 'N', 'D')
+#define AIFFSCRUBBER_NONE PCMFILESCRUBBER_ID('N', 'O', 'N', 'E')
+#define AIFFSCRUBBER_TWOS PCMFILESCRUBBER_ID('t', 'w', 'o', 's')
+#define AIFFSCRUBBER_SOWT PCMFILESCRUBBER_ID('s', 'o', 'w', 't')
+// Channels, sample frames, sample size and the 80-bit sample rate
+#define AIFFSCRUBBER_COMM_SIZE 18
+// Followed by the compression type in AIFF-C files
+#define AIFFSCRUBBER_AIFC_COMM_SIZE 22
+// Offset and block size, ahead of the samples
+#define AIFFSCRUBBER_SSND_HEADER_SIZE 8
+
+// Text chunks that have a Vorbis comment counterpart; they are kept when it is whitelisted, the others never are
+static const struct {
+	uint32_t id;
+	const char * tag;
+} textTags[] = {
+	{PCMFILESCRUBBER_ID('N', 'A', 'M', 'E'), "title"},
+	{PCMFILESCRUBBER_ID('A', 'U', 'T', 'H'), "artist"},
+	{PCMFILESCRUBBER_ID('(', 'c', ')', ' '), "copyright"},
+	{PCMFILESCRUBBER_ID('A', 'N', 'N', 'O'), "comment"}
+};
+
+AIFFScrubber::AIFFScrubber(std::string file) : PCMFileScrubber(file) {
+}
+
+bool AIFFScrubber::parse() {
+	const uint8_t * data = aMappedFile.data();
+	uint64_t size = aMappedFile.size();
+	aFormType = size >= 12 ? readLE32(data + 8) : 0;
+	error(size >= 12 && readLE32(data) == AIFFSCRUBBER_FORM && (aFormType == AIFFSCRUBBER_AIFF || aFormType == AIFFSCRUBBER_AIFC), "Not an AIFF file.");
+	if(hasError()) {
+		return false;
+	}
+	// Anything past the FORM chunk is not part of the file
+	uint64_t end = std::min(size, 8 + (uint64_t) readBE32(data + 4));
+	bool hasCommon = false;
+	bool hasSound = false;
+	for(uint64_t offset = 12; offset + 8 <= end; ) {
+		Chunk chunk;
+		// Identifiers are compared as they appear in the file, sizes are big-endian
+		chunk.id = readLE32(data + offset);
+		chunk.size = readBE32(data + offset + 4);
+		chunk.offset = offset + 8;
+		error(chunk.offset + chunk.size <= end, "The file is truncated.");
+		if(hasError()) {
+			return false;
+		}
+		if(chunk.id == AIFFSCRUBBER_COMM && !hasCommon) {
+			if(!parseCommon(chunk)) {
+				return false;
+			}
+			aCommonChunk = aChunks.size();
+			hasCommon = true;
+		} else if(chunk.id == AIFFSCRUBBER_SSND) {
+			error(!hasSound, "More than one sound data chunk.");
+			error(chunk.size >= AIFFSCRUBBER_SSND_HEADER_SIZE, "Sound data chunk too short.");
+			if(hasError()) {
+				return false;
+			}
+			// Samples may start further in, usually to align them to blocks; the scrubbed file does without that
+			uint64_t soundOffset = AIFFSCRUBBER_SSND_HEADER_SIZE + (uint64_t) readBE32(data + chunk.offset);
+			error(soundOffset <= chunk.size, "Sound data offset past the end of the chunk.");
+			if(hasError()) {
+				return false;
+			}
+			aSamplesChunk = aChunks.size();
+			aSamplesOffset = chunk.offset + soundOffset;
+			aSamplesSize = chunk.size - soundOffset;
+			hasSound = true;
+		}
+		aChunks.push_back(chunk);
+		offset = chunk.offset + chunk.size + (chunk.size & 1);
+	}
+	error(hasCommon, "No common chunk.");
+	error(hasSound, "No sound data chunk.");
+	return !hasError();
+}
+
+bool AIFFScrubber::parseCommon(const Chunk & chunk) {
+	const uint8_t * body = aMappedFile.data() + chunk.offset;
+	error(chunk.size >= (aFormType == AIFFSCRUBBER_AIFC ? AIFFSCRUBBER_AIFC_COMM_SIZE : AIFFSCRUBBER_COMM_SIZE), "Common chunk too short.");
+	if(hasError()) {
+		return false;
+	}
+	aNumChannels = readBE16(body);
+	unsigned bits = readBE16(body + 6);
+	// Samples sit in the top bits of signed containers of whole bytes
+	aLayout.bytesPerSample = (bits + 7) / 8;
+	aLayout.bitsPerSample = bits;
+	aLayout.bigEndian = true;
+	aLayout.isUnsigned = false;
+	if(aFormType == AIFFSCRUBBER_AIFC) {
+		uint32_t compression = readLE32(body + 18);
+		error(compression == AIFFSCRUBBER_NONE || compression == AIFFSCRUBBER_TWOS || compression == AIFFSCRUBBER_SOWT, "Only uncompressed integer AIFF-C files are supported.");
+		aLayout.bigEndian = compression != AIFFSCRUBBER_SOWT;
+	}
+	error(PCMCodec::isSupported(aLayout) && aNumChannels > 0, "Unsupported sample format.");
+	return !hasError();
+}
+
+bool AIFFScrubber::rebuildChunk(size_t index, uint64_t fileSize, std::vector<uint8_t> & body) {
+	const Chunk & chunk = aChunks[index];
+	const uint8_t * data = aMappedFile.data() + chunk.offset;
+	if((chunk.id == AIFFSCRUBBER_COMM && index == aCommonChunk) || chunk.id == AIFFSCRUBBER_FVER) {
+		body.assign(data, data + chunk.size);
+		return true;
+	}
+	if(index == aSamplesChunk) {
+		// No offset and no block size: the samples follow right away
+		body.assign(AIFFSCRUBBER_SSND_HEADER_SIZE, 0);
+		return true;
+	}
+	for(size_t i = 0; i < sizeof(textTags) / sizeof(textTags[0]); i++) {
+		if(textTags[i].id == chunk.id) {
+			if(!aAllowedTags.contains(textTags[i].tag, strlen(textTags[i].tag))) {
+				return false;
+			}
+			body.assign(data, data + chunk.size);
+			return true;
+		}
+	}
+	return false;
+}
+
+void AIFFScrubber::appendFileHeader(std::vector<uint8_t> & out, uint64_t fileSize) {
+	appendLE32(out, AIFFSCRUBBER_FORM);
+	appendBE32(out, (uint32_t) (fileSize - 8));
+	appendLE32(out, aFormType);
+}
+
+void AIFFScrubber::appendChunkHeader(std::vector<uint8_t> & out, uint32_t id, uint64_t size) {
+	appendLE32(out, id);
+	appendBE32(out, (uint32_t) size);
+}
@@ -0,0 +1,60 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef AIFFSCRUBBER_H
+#define AIFFSCRUBBER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "pcmfilescrubber.h"
+
+#define AIFFSCRUBBER_FORM PCMFILESCRUBBER_ID('F', 'O', 'R', 'M')
+#define AIFFSCRUBBER_AIFF PCMFILESCRUBBER_ID('A', 'I', 'F', 'F')
+#define AIFFSCRUBBER_AIFC PCMFILESCRUBBER_ID('A', 'I', 'F', 'C')
+
+// AIFF and uncompressed AIFF-C files, big-endian or, with the sowt compression type, little-endian.
+// The common, format version and sound data chunks are kept, and the name, author, copyright and
+// annotation chunks when their Vorbis comment counterpart is whitelisted. Everything else (markers,
+// instrument and MIDI data, application chunks, ID3 tags...) is dropped.
+class AIFFScrubber : public PCMFileScrubber
+{
+	public:
+		AIFFScrubber(std::string file);
+	protected:
+		bool parse();
+		bool rebuildChunk(size_t index, uint64_t fileSize, std::vector<uint8_t> & body);
+		void appendFileHeader(std::vector<uint8_t> & out, uint64_t fileSize);
+		void appendChunkHeader(std::vector<uint8_t> & out, uint32_t id, uint64_t size);
+	private:
+		uint32_t aFormType = 0;
+		size_t aCommonChunk = 0;
+		bool parseCommon(const Chunk & chunk);
+};
+
+#endif // AIFFSCRUBBER_H
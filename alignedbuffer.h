@@ -0,0 +1,76 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef ALIGNEDBUFFER_H
+#define ALIGNEDBUFFER_H
+
+#include <stdlib.h>
+#include <new>
+
+#define ALIGNEDBUFFER_ALIGNMENT 64
+
+// Scratch buffer aligned to a cache line. It only ever grows, and does not keep its contents when it does,
+// so once it has been reserved for the largest size it will see, reusing it never allocates.
+template<typename T> class AlignedBuffer
+{
+	public:
+		AlignedBuffer() {
+		}
+		AlignedBuffer(AlignedBuffer && other) : aData(other.aData), aCapacity(other.aCapacity) {
+			other.aData = nullptr;
+			other.aCapacity = 0;
+		}
+		AlignedBuffer(const AlignedBuffer &) = delete;
+		AlignedBuffer & operator=(const AlignedBuffer &) = delete;
+		~AlignedBuffer() {
+			free(aData);
+		}
+		void reserve(size_t count) {
+			if(count <= aCapacity) {
+				return;
+			}
+			void * data;
+			if(posix_memalign(&data, ALIGNEDBUFFER_ALIGNMENT, count * sizeof(T)) != 0) {
+				throw std::bad_alloc();
+			}
+			free(aData);
+			aData = (T *) data;
+			aCapacity = count;
+		}
+		T * data() {
+			return aData;
+		}
+		size_t capacity() {
+			return aCapacity;
+		}
+	private:
+		T * aData = nullptr;
+		size_t aCapacity = 0;
+};
+
+#endif // ALIGNEDBUFFER_H
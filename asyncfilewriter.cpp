@@ -0,0 +1,351 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include "asyncfilewriter.h"
+
+AsyncFileWriter::AsyncFileWriter() : aBuffers(ASYNCFILEWRITER_BUFFERS), aSubmittedBuffers(ASYNCFILEWRITER_BUFFERS + 1), aCompletedBuffers(ASYNCFILEWRITER_BUFFERS) {
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+	close();
+}
+
+bool AsyncFileWriter::open(std::string file) {
+	close();
+	aLinkPath.clear();
+#ifdef O_TMPFILE
+	if(!aNamed) {
+		aDescriptor = ::open(getDirectory(file).c_str(), O_TMPFILE | O_WRONLY, 0666);
+		if(aDescriptor != -1) {
+			aLinkPath = file;
+		}
+	}
+#endif
+	if(aDescriptor == -1) {
+		// Old kernel, or a file system without unnamed files
+		aDescriptor = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	}
+	if(aDescriptor == -1) {
+		return false;
+	}
+	aOwnsDescriptor = true;
+	aSequential = false;
+	start(0);
+	return true;
+}
+
+bool AsyncFileWriter::reopen(std::string file, off_t size) {
+	close();
+	aLinkPath.clear();
+	aDescriptor = ::open(file.c_str(), O_WRONLY);
+	if(aDescriptor == -1) {
+		return false;
+	}
+	struct stat status;
+	if(fstat(aDescriptor, &status) != 0 || status.st_size < size || ftruncate(aDescriptor, size) != 0) {
+		::close(aDescriptor);
+		aDescriptor = -1;
+		return false;
+	}
+	aOwnsDescriptor = true;
+	aSequential = false;
+	start(size);
+	return true;
+}
+
+bool AsyncFileWriter::openStream(int descriptor) {
+	close();
+	aLinkPath.clear();
+	aDescriptor = descriptor;
+	aOwnsDescriptor = false;
+	aSequential = true;
+	start(0);
+	return true;
+}
+
+void AsyncFileWriter::setSync(bool sync) {
+	aSync = sync;
+}
+
+void AsyncFileWriter::setNamed(bool named) {
+	aNamed = named;
+}
+
+void AsyncFileWriter::start(off_t size) {
+	aFreeBuffers.clear();
+	for(Buffer & buffer : aBuffers) {
+		buffer.data.reserve(ASYNCFILEWRITER_BUFFER_SIZE);
+		aFreeBuffers.push_back(&buffer);
+	}
+	aCurrentBuffer = nullptr;
+	aPendingBuffers = 0;
+	aSize = size;
+	aFailed = false;
+#ifdef HAVE_IO_URING
+	// Writes in flight on the ring may complete in any order, which only works with explicit offsets
+	aRingReady = !aSequential && aRing.setup(ASYNCFILEWRITER_BUFFERS);
+	if(aRingReady) {
+		return;
+	}
+#endif
+	aWriteThread = std::thread(&AsyncFileWriter::writeStage, this);
+}
+
+bool AsyncFileWriter::write(const void * data, size_t length, off_t offset) {
+	if(aDescriptor == -1 || aFailed || offset > aSize || (aSequential && offset < aSize)) {
+		return false;
+	}
+	const uint8_t * bytes = (const uint8_t *) data;
+	if(offset < aSize) {
+		// Whatever falls in the buffer being filled is patched there, the rest has already been submitted
+		size_t rewritten = (size_t) std::min((off_t) length, aSize - offset);
+		off_t buffered = aCurrentBuffer != nullptr ? aCurrentBuffer->offset : aSize;
+		if(offset + (off_t) rewritten > buffered) {
+			off_t start = std::max(offset, buffered);
+			memcpy(aCurrentBuffer->data.data() + (start - buffered), bytes + (start - offset), offset + rewritten - start);
+		}
+		if(offset < buffered) {
+			drain();
+			size_t submitted = (size_t) std::min((off_t) rewritten, buffered - offset);
+			if(!writeFully(bytes, submitted, offset)) {
+				aFailed = true;
+			}
+		}
+		bytes += rewritten;
+		length -= rewritten;
+	}
+	while(length > 0 && !aFailed) {
+		if(aCurrentBuffer == nullptr) {
+			if(aFreeBuffers.empty()) {
+				Buffer * buffer = waitBuffer();
+				if(buffer == nullptr) {
+					return false;
+				}
+				aFreeBuffers.push_back(buffer);
+			}
+			aCurrentBuffer = aFreeBuffers.back();
+			aFreeBuffers.pop_back();
+			aCurrentBuffer->length = 0;
+			aCurrentBuffer->offset = aSize;
+		}
+		size_t chunk = std::min(length, ASYNCFILEWRITER_BUFFER_SIZE - aCurrentBuffer->length);
+		memcpy(aCurrentBuffer->data.data() + aCurrentBuffer->length, bytes, chunk);
+		aCurrentBuffer->length += chunk;
+		aSize += chunk;
+		bytes += chunk;
+		length -= chunk;
+		if(aCurrentBuffer->length == ASYNCFILEWRITER_BUFFER_SIZE) {
+			submit(aCurrentBuffer);
+			aCurrentBuffer = nullptr;
+		}
+	}
+	return !aFailed;
+}
+
+bool AsyncFileWriter::append(const void * data, size_t length) {
+	return write(data, length, aSize);
+}
+
+off_t AsyncFileWriter::getSize() {
+	return aSize;
+}
+
+bool AsyncFileWriter::sync() {
+	if(aDescriptor == -1 || aFailed) {
+		return false;
+	}
+	if(aCurrentBuffer != nullptr) {
+		submit(aCurrentBuffer);
+		aCurrentBuffer = nullptr;
+	}
+	drain();
+	if(aFailed) {
+		return false;
+	}
+	return !aOwnsDescriptor || fdatasync(aDescriptor) == 0;
+}
+
+bool AsyncFileWriter::close() {
+	if(aDescriptor == -1) {
+		return true;
+	}
+	if(aCurrentBuffer != nullptr && !aFailed) {
+		submit(aCurrentBuffer);
+	}
+	aCurrentBuffer = nullptr;
+	drain();
+#ifdef HAVE_IO_URING
+	if(aRingReady) {
+		aRing.close();
+		aRingReady = false;
+	}
+#endif
+	if(aWriteThread.joinable()) {
+		aSubmittedBuffers.push(nullptr);
+		aWriteThread.join();
+	}
+	if(aOwnsDescriptor && aSync && !aFailed && fsync(aDescriptor) != 0) {
+		aFailed = true;
+	}
+	if(!aLinkPath.empty() && !aFailed && !link()) {
+		aFailed = true;
+	}
+	bool success = !aFailed;
+	if(aOwnsDescriptor) {
+		success = ::close(aDescriptor) == 0 && success;
+	}
+	aDescriptor = -1;
+	return success;
+}
+
+void AsyncFileWriter::submit(Buffer * buffer) {
+	buffer->failed = false;
+	aPendingBuffers++;
+#ifdef HAVE_IO_URING
+	if(aRingReady) {
+		if(!aRing.submitWrite(aDescriptor, buffer->data.data(), buffer->length, buffer->offset, (uint64_t) (buffer - &aBuffers[0]))) {
+			// Nothing will complete, so write it here instead
+			buffer->failed = !writeFully(buffer->data.data(), buffer->length, buffer->offset);
+			aFailed = aFailed || buffer->failed;
+			aPendingBuffers--;
+			aFreeBuffers.push_back(buffer);
+		}
+		return;
+	}
+#endif
+	aSubmittedBuffers.push(buffer);
+}
+
+AsyncFileWriter::Buffer * AsyncFileWriter::waitBuffer() {
+	Buffer * buffer;
+#ifdef HAVE_IO_URING
+	if(aRingReady) {
+		uint64_t index;
+		int result;
+		if(!aRing.waitCompletion(&index, &result)) {
+			// Without completions there is no telling which writes went through, so give up on the file
+			aPendingBuffers = 0;
+			aFailed = true;
+			return nullptr;
+		}
+		buffer = &aBuffers[index];
+		if(result != (int) buffer->length) {
+			// Short or failed write, which pwrite() will either finish or explain
+			size_t written = result > 0 ? (size_t) result : 0;
+			buffer->failed = !writeFully(buffer->data.data() + written, buffer->length - written, buffer->offset + written);
+		}
+	} else
+#endif
+	{
+		buffer = aCompletedBuffers.pop();
+	}
+	aPendingBuffers--;
+	aFailed = aFailed || buffer->failed;
+	return buffer;
+}
+
+void AsyncFileWriter::drain() {
+	while(aPendingBuffers > 0) {
+		Buffer * buffer = waitBuffer();
+		if(buffer == nullptr) {
+			return;
+		}
+		aFreeBuffers.push_back(buffer);
+	}
+}
+
+void AsyncFileWriter::writeStage() {
+	for(Buffer * buffer = aSubmittedBuffers.pop(); buffer != nullptr; buffer = aSubmittedBuffers.pop()) {
+		buffer->failed = !writeFully(buffer->data.data(), buffer->length, buffer->offset);
+		aCompletedBuffers.push(buffer);
+	}
+}
+
+bool AsyncFileWriter::writeFully(const uint8_t * data, size_t length, off_t offset) {
+	while(length > 0) {
+		// Buffers reach the write thread in order, so sequential output can go wherever the descriptor is
+		ssize_t written = aSequential ? ::write(aDescriptor, data, length) : pwrite(aDescriptor, data, length, offset);
+		if(written < 0 && errno == EINTR) {
+			continue;
+		}
+		if(written <= 0) {
+			return false;
+		}
+		data += written;
+		length -= written;
+		offset += written;
+	}
+	return true;
+}
+
+bool AsyncFileWriter::link() {
+	// linkat() with AT_EMPTY_PATH needs privileges, the descriptor's /proc entry does not
+	std::string descriptorPath = "/proc/self/fd/" + std::to_string(aDescriptor);
+	if(linkat(AT_FDCWD, descriptorPath.c_str(), AT_FDCWD, aLinkPath.c_str(), AT_SYMLINK_FOLLOW) == 0) {
+		return true;
+	}
+	if(errno != EEXIST) {
+		return false;
+	}
+	// Left over from an interrupted run
+	if(unlink(aLinkPath.c_str()) != 0) {
+		return false;
+	}
+	return linkat(AT_FDCWD, descriptorPath.c_str(), AT_FDCWD, aLinkPath.c_str(), AT_SYMLINK_FOLLOW) == 0;
+}
+
+bool AsyncFileWriter::syncDirectory(std::string file) {
+	int descriptor = ::open(getDirectory(file).c_str(), O_RDONLY | O_DIRECTORY);
+	if(descriptor == -1) {
+		return false;
+	}
+	bool success = fsync(descriptor) == 0;
+	return ::close(descriptor) == 0 && success;
+}
+
+bool AsyncFileWriter::replace(std::string file, std::string original, bool sync) {
+	if(std::rename(file.c_str(), original.c_str()) != 0) {
+		return false;
+	}
+	return !sync || syncDirectory(original);
+}
+
+std::string AsyncFileWriter::getDirectory(std::string file) {
+	size_t separator = file.find_last_of('/');
+	if(separator == std::string::npos) {
+		return ".";
+	}
+	return separator == 0 ? "/" : file.substr(0, separator);
+}
@@ -0,0 +1,119 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef ASYNCFILEWRITER_H
+#define ASYNCFILEWRITER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "alignedbuffer.h"
+#include "boundedqueue.h"
+#ifdef HAVE_IO_URING
+#include "iouring.h"
+#endif
+
+#define ASYNCFILEWRITER_BUFFER_SIZE (1 << 20)
+#define ASYNCFILEWRITER_BUFFERS 8
+
+// Writes a file through a ring of large buffers that are flushed in the background, so that
+// the caller only waits for the disk once every buffer is in flight. Buffers are submitted
+// through io_uring when the kernel allows it, and handed to a thread doing plain pwrite()
+// otherwise. Data is mostly appended; writes before the end, such as a header rewritten
+// once the stream is finished, are patched into the last buffer or written in place.
+// Pipes and other descriptors that cannot seek only support appending, in order.
+// Where the file system supports it, a file is written unnamed (O_TMPFILE) and only linked
+// under its name once close() succeeds, so a partial file never shows up.
+class AsyncFileWriter
+{
+	public:
+		AsyncFileWriter();
+		~AsyncFileWriter();
+		bool open(std::string file);
+		// Continues a file left by an earlier run, discarding anything past size; the file keeps its name throughout
+		bool reopen(std::string file, off_t size);
+		// Writes to an already open descriptor that may not be seekable, such as standard output; close() leaves it open
+		bool openStream(int descriptor);
+		// Makes close() flush the file to disk before naming it; has no effect on streams
+		void setSync(bool sync);
+		// Makes open() create the file under its name right away, so that it outlives a crash and can be reopened
+		void setNamed(bool named);
+		// offset may be anywhere up to the end of what has been written so far
+		bool write(const void * data, size_t length, off_t offset);
+		bool append(const void * data, size_t length);
+		off_t getSize();
+		// Waits for everything written so far to reach the disk; writing can go on afterwards
+		bool sync();
+		// Waits for every write to complete; false if any of them failed
+		bool close();
+		// Flushes the directory entries of the directory containing file to disk
+		static bool syncDirectory(std::string file);
+		// Renames file over original in one step, so that there is always one version of it or the other,
+		// then flushes the directory to disk if sync is set
+		static bool replace(std::string file, std::string original, bool sync);
+	private:
+		struct Buffer {
+			AlignedBuffer<uint8_t> data;
+			size_t length;
+			off_t offset;
+			bool failed;
+		};
+		int aDescriptor = -1;
+		bool aOwnsDescriptor = false;
+		bool aSequential = false;
+		bool aSync = false;
+		bool aNamed = false;
+		std::string aLinkPath; // Name to give the unnamed file on close(), if it is one
+		std::vector<Buffer> aBuffers;
+		std::vector<Buffer *> aFreeBuffers;
+		Buffer * aCurrentBuffer = nullptr;
+		unsigned aPendingBuffers = 0;
+		off_t aSize = 0;
+		bool aFailed = false;
+#ifdef HAVE_IO_URING
+		IOUring aRing;
+		bool aRingReady = false;
+#endif
+		BoundedQueue<Buffer *> aSubmittedBuffers;
+		BoundedQueue<Buffer *> aCompletedBuffers;
+		std::thread aWriteThread;
+		void submit(Buffer * buffer);
+		Buffer * waitBuffer();
+		void drain();
+		void start(off_t size);
+		void writeStage();
+		bool writeFully(const uint8_t * data, size_t length, off_t offset);
+		bool link();
+		static std::string getDirectory(std::string file);
+		AsyncFileWriter(const AsyncFileWriter &) = delete;
+		AsyncFileWriter & operator=(const AsyncFileWriter &) = delete;
+};
+
+#endif // ASYNCFILEWRITER_H
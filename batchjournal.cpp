@@ -0,0 +1,160 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "batchjournal.h"
+
+#define BATCHJOURNAL_START 'S'
+#define BATCHJOURNAL_COMMIT 'C'
+#define BATCHJOURNAL_FAILURE 'F'
+
+BatchJournal::BatchJournal() {
+}
+
+BatchJournal::~BatchJournal() {
+	close();
+}
+
+bool BatchJournal::open(std::string file) {
+	close();
+	aStates.clear();
+	off_t validLength = 0;
+	if(!read(file, &validLength)) {
+		return false;
+	}
+	aDescriptor = ::open(file.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0666);
+	if(aDescriptor == -1) {
+		return false;
+	}
+	// Drop a record cut short by a crash, so that new records do not end up behind it
+	struct stat status;
+	if(fstat(aDescriptor, &status) != 0 || (status.st_size > validLength && ftruncate(aDescriptor, validLength) != 0)) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool BatchJournal::close() {
+	if(aDescriptor == -1) {
+		return true;
+	}
+	bool success = fdatasync(aDescriptor) == 0;
+	success = ::close(aDescriptor) == 0 && success;
+	aDescriptor = -1;
+	return success;
+}
+
+bool BatchJournal::isCommitted(std::string file) {
+	std::lock_guard<std::mutex> lock(aMutex);
+	std::map<std::string, char>::iterator it = aStates.find(file);
+	return it != aStates.end() && it->second == BATCHJOURNAL_COMMIT;
+}
+
+std::vector<std::string> BatchJournal::getInterrupted() {
+	std::lock_guard<std::mutex> lock(aMutex);
+	std::vector<std::string> files;
+	for(std::map<std::string, char>::iterator it = aStates.begin(); it != aStates.end(); it++) {
+		if(it->second == BATCHJOURNAL_START) {
+			files.push_back(it->first);
+		}
+	}
+	return files;
+}
+
+void BatchJournal::recordStart(std::string file) {
+	record(BATCHJOURNAL_START, file);
+}
+
+void BatchJournal::recordCommit(std::string file) {
+	record(BATCHJOURNAL_COMMIT, file);
+}
+
+void BatchJournal::recordFailure(std::string file) {
+	record(BATCHJOURNAL_FAILURE, file);
+}
+
+bool BatchJournal::read(std::string file, off_t * validLength) {
+	int descriptor = ::open(file.c_str(), O_RDONLY);
+	if(descriptor == -1) {
+		return errno == ENOENT;
+	}
+	std::string contents;
+	char buffer[65536];
+	ssize_t length;
+	while((length = ::read(descriptor, buffer, sizeof(buffer))) != 0) {
+		if(length < 0 && errno == EINTR) {
+			continue;
+		}
+		if(length < 0) {
+			::close(descriptor);
+			return false;
+		}
+		contents.append(buffer, length);
+	}
+	::close(descriptor);
+	size_t position = 0;
+	while(position + 2 < contents.size()) {
+		char state = contents[position];
+		if(contents[position + 1] != ' ') {
+			break;
+		}
+		char * end;
+		unsigned long nameLength = strtoul(contents.c_str() + position + 2, &end, 10);
+		size_t nameStart = end - contents.c_str() + 1;
+		if(*end != ' ' || nameStart + nameLength >= contents.size() || contents[nameStart + nameLength] != '\n') {
+			break;
+		}
+		aStates[contents.substr(nameStart, nameLength)] = state;
+		position = nameStart + nameLength + 1;
+	}
+	*validLength = position;
+	return true;
+}
+
+void BatchJournal::record(char state, std::string file) {
+	std::string line(1, state);
+	line += " " + std::to_string(file.size()) + " " + file + "\n";
+	std::lock_guard<std::mutex> lock(aMutex);
+	aStates[file] = state;
+	if(aDescriptor == -1) {
+		return;
+	}
+	// A single write() on an O_APPEND descriptor keeps the record in one piece
+	if(write(aDescriptor, line.data(), line.size()) != (ssize_t) line.size()) {
+		return;
+	}
+	if(++aUnsyncedRecords >= BATCHJOURNAL_SYNC_RECORDS) {
+		fdatasync(aDescriptor);
+		aUnsyncedRecords = 0;
+	}
+}
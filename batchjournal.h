@@ -0,0 +1,71 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef BATCHJOURNAL_H
+#define BATCHJOURNAL_H
+
+#include <sys/types.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Records written before being flushed to disk together
+#define BATCHJOURNAL_SYNC_RECORDS 32
+
+// Append-only record of which files of a batch were started, committed or failed, so that an
+// interrupted batch can pick up where it left off. Each record is a line "S|C|F <length> <file>",
+// the length making any file name safe to store; a record cut short by a crash is ignored.
+// Records are flushed to disk in groups, so the last few may be lost, which only means that
+// those files are scrubbed again.
+class BatchJournal
+{
+	public:
+		BatchJournal();
+		~BatchJournal();
+		// Reads the records already in the journal, if any, and appends new ones after them
+		bool open(std::string file);
+		bool close();
+		bool isCommitted(std::string file);
+		// Files that were started but neither committed nor failed, which the crash interrupted
+		std::vector<std::string> getInterrupted();
+		void recordStart(std::string file);
+		void recordCommit(std::string file);
+		void recordFailure(std::string file);
+	private:
+		int aDescriptor = -1;
+		unsigned aUnsyncedRecords = 0;
+		std::map<std::string, char> aStates; // Last record of each file
+		std::mutex aMutex;
+		bool read(std::string file, off_t * validLength);
+		void record(char state, std::string file);
+		BatchJournal(const BatchJournal &) = delete;
+		BatchJournal & operator=(const BatchJournal &) = delete;
+};
+
+#endif // BATCHJOURNAL_H
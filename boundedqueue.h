@@ -0,0 +1,68 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// Blocking FIFO shared between pipeline stages; push() waits while the queue is full, pop() while it is empty.
+template<typename T> class BoundedQueue
+{
+	public:
+		BoundedQueue(size_t capacity) : aCapacity(capacity) {
+		}
+		// Only while no other thread uses the queue
+		void setCapacity(size_t capacity) {
+			aCapacity = capacity;
+		}
+		void push(T item) {
+			std::unique_lock<std::mutex> lock(aMutex);
+			aNotFull.wait(lock, [this]() { return aItems.size() < aCapacity; });
+			aItems.push_back(item);
+			aNotEmpty.notify_one();
+		}
+		T pop() {
+			std::unique_lock<std::mutex> lock(aMutex);
+			aNotEmpty.wait(lock, [this]() { return !aItems.empty(); });
+			T item = aItems.front();
+			aItems.pop_front();
+			aNotFull.notify_one();
+			return item;
+		}
+	private:
+		std::deque<T> aItems;
+		size_t aCapacity;
+		std::mutex aMutex;
+		std::condition_variable aNotEmpty;
+		std::condition_variable aNotFull;
+};
+
+#endif // BOUNDEDQUEUE_H
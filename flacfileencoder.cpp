@@ -0,0 +1,87 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "flacfileencoder.h"
+
+FLACFileEncoder::FLACFileEncoder() : FLAC::Encoder::Stream() {
+}
+
+FLACFileEncoder::~FLACFileEncoder() {
+}
+
+FLAC__StreamEncoderInitStatus FLACFileEncoder::init(std::string file) {
+	if(!aWriter.open(file)) {
+		return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
+	}
+	aPosition = 0;
+	aSeekable = true;
+	return FLAC::Encoder::Stream::init();
+}
+
+FLAC__StreamEncoderInitStatus FLACFileEncoder::initStream(int descriptor) {
+	if(!aWriter.openStream(descriptor)) {
+		return FLAC__STREAM_ENCODER_INIT_STATUS_ENCODER_ERROR;
+	}
+	aPosition = 0;
+	aSeekable = false;
+	return FLAC::Encoder::Stream::init();
+}
+
+void FLACFileEncoder::setSync(bool sync) {
+	aWriter.setSync(sync);
+}
+
+bool FLACFileEncoder::finish() {
+	// finish() rewrites the metadata blocks, so the file can only be closed afterwards
+	bool finished = FLAC::Encoder::Stream::finish();
+	return aWriter.close() && finished;
+}
+
+FLAC__StreamEncoderWriteStatus FLACFileEncoder::write_callback(const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame) {
+	if(!aWriter.write(buffer, bytes, (off_t) aPosition)) {
+		return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+	}
+	aPosition += bytes;
+	return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+FLAC__StreamEncoderSeekStatus FLACFileEncoder::seek_callback(FLAC__uint64 absolute_byte_offset) {
+	if(!aSeekable) {
+		return FLAC__STREAM_ENCODER_SEEK_STATUS_UNSUPPORTED;
+	}
+	if(absolute_byte_offset > (FLAC__uint64) aWriter.getSize()) {
+		return FLAC__STREAM_ENCODER_SEEK_STATUS_ERROR;
+	}
+	aPosition = absolute_byte_offset;
+	return FLAC__STREAM_ENCODER_SEEK_STATUS_OK;
+}
+
+FLAC__StreamEncoderTellStatus FLACFileEncoder::tell_callback(FLAC__uint64 * absolute_byte_offset) {
+	*absolute_byte_offset = aPosition;
+	return FLAC__STREAM_ENCODER_TELL_STATUS_OK;
+}
@@ -0,0 +1,59 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef FLACFILEENCODER_H
+#define FLACFILEENCODER_H
+
+#include "FLAC++/encoder.h"
+#include <string>
+#include "asyncfilewriter.h"
+
+// A FLAC stream encoder that writes its file through an AsyncFileWriter instead of stdio,
+// so that encoding does not wait for the disk. Seeking back to rewrite STREAMINFO and the
+// seek table once the stream is finished turns into positioned writes. When writing to a stream
+// that cannot seek, libFLAC leaves the metadata blocks as they were first written instead.
+class FLACFileEncoder : public FLAC::Encoder::Stream
+{
+	public:
+		FLACFileEncoder();
+		virtual ~FLACFileEncoder();
+		FLAC__StreamEncoderInitStatus init(std::string file);
+		FLAC__StreamEncoderInitStatus initStream(int descriptor);
+		void setSync(bool sync);
+		virtual bool finish();
+	protected:
+		virtual FLAC__StreamEncoderWriteStatus write_callback(const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame);
+		virtual FLAC__StreamEncoderSeekStatus seek_callback(FLAC__uint64 absolute_byte_offset);
+		virtual FLAC__StreamEncoderTellStatus tell_callback(FLAC__uint64 * absolute_byte_offset);
+	private:
+		AsyncFileWriter aWriter;
+		FLAC__uint64 aPosition = 0;
+		bool aSeekable = true;
+};
+
+#endif // FLACFILEENCODER_H
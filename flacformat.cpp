@@ -0,0 +1,251 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <string.h>
+#include "flacformat.h"
+
+#define FLACFORMAT_STREAMINFO_LENGTH 34
+#define FLACFORMAT_SEEKPOINT_LENGTH 18
+
+namespace FLACFormat {
+
+static FLAC__byte crc8Table[256];
+static FLAC__uint16 crc16Table[256];
+
+static bool initializeCrcTables() {
+	for(unsigned i = 0; i < 256; i++) {
+		FLAC__byte crc8 = (FLAC__byte) i;
+		FLAC__uint16 crc16 = (FLAC__uint16) (i << 8);
+		for(int bit = 0; bit < 8; bit++) {
+			crc8 = (FLAC__byte) ((crc8 & 0x80) ? (crc8 << 1) ^ 0x07 : crc8 << 1);
+			crc16 = (FLAC__uint16) ((crc16 & 0x8000) ? (crc16 << 1) ^ 0x8005 : crc16 << 1);
+		}
+		crc8Table[i] = crc8;
+		crc16Table[i] = crc16;
+	}
+	return true;
+}
+
+static const bool crcTablesInitialized = initializeCrcTables();
+
+FLAC__byte crc8(const FLAC__byte * data, size_t length) {
+	FLAC__byte crc = 0;
+	while(length--) {
+		crc = crc8Table[crc ^ *data++];
+	}
+	return crc;
+}
+
+FLAC__uint16 crc16(const FLAC__byte * data, size_t length, FLAC__uint16 crc) {
+	while(length--) {
+		crc = (FLAC__uint16) ((crc << 8) ^ crc16Table[(crc >> 8) ^ *data++]);
+	}
+	return crc;
+}
+
+static unsigned codedNumberLength(FLAC__byte firstByte) {
+	if(!(firstByte & 0x80)) {
+		return 1;
+	}
+	for(unsigned length = 2; length <= 7; length++) {
+		if(!(firstByte & (0x80 >> length))) {
+			return length;
+		}
+	}
+	return 7; // 0xFE
+}
+
+static void appendCodedNumber(std::vector<FLAC__byte> & out, FLAC__uint64 number) {
+	if(number < 0x80) {
+		out.push_back((FLAC__byte) number);
+		return;
+	}
+	unsigned length = 2;
+	while(length < 7 && number >= (1ULL << (5 * length + 1))) {
+		length++;
+	}
+	out.push_back((FLAC__byte) ((0xFF00 >> length) | (number >> (6 * (length - 1)))));
+	for(int shift = 6 * (length - 2); shift >= 0; shift -= 6) {
+		out.push_back((FLAC__byte) (0x80 | ((number >> shift) & 0x3F)));
+	}
+}
+
+bool parseFrameHeader(const FLAC__byte * data, size_t length, FrameHeader * header) {
+	if(length < 6 || data[0] != 0xFF || (data[1] & 0xFE) != 0xF8) {
+		return false;
+	}
+	unsigned blocksizeCode = data[2] >> 4;
+	unsigned sampleRateCode = data[2] & 0x0F;
+	if(blocksizeCode == 0 || sampleRateCode == 0x0F || (data[3] >> 4) > 10 || ((data[3] >> 1) & 0x07) == 3 || (data[3] & 0x01)) {
+		return false;
+	}
+	header->variableBlocksize = data[1] & 0x01;
+	header->numberOffset = 4;
+	header->numberLength = codedNumberLength(data[4]);
+	// Frame numbers are at most 31 bits long (6 bytes), sample numbers at most 36 bits (7 bytes)
+	if(data[4] == 0xFF || (data[4] & 0xC0) == 0x80 || (!header->variableBlocksize && header->numberLength > 6)) {
+		return false;
+	}
+	size_t position = 4 + header->numberLength;
+	if(position + 1 > length) {
+		return false;
+	}
+	header->number = header->numberLength == 1 ? data[4] : data[4] & (0x7F >> header->numberLength);
+	for(unsigned i = 1; i < header->numberLength; i++) {
+		if((data[4 + i] & 0xC0) != 0x80) {
+			return false;
+		}
+		header->number = (header->number << 6) | (data[4 + i] & 0x3F);
+	}
+	if(blocksizeCode == 1) {
+		header->blocksize = 192;
+	} else if(blocksizeCode <= 5) {
+		header->blocksize = 576 << (blocksizeCode - 2);
+	} else if(blocksizeCode == 6) {
+		if(position + 2 > length) {
+			return false;
+		}
+		header->blocksize = data[position] + 1;
+		position += 1;
+	} else if(blocksizeCode == 7) {
+		if(position + 3 > length) {
+			return false;
+		}
+		header->blocksize = ((data[position] << 8) | data[position + 1]) + 1;
+		position += 2;
+	} else {
+		header->blocksize = 256 << (blocksizeCode - 8);
+	}
+	if(sampleRateCode == 12) {
+		position += 1;
+	} else if(sampleRateCode == 13 || sampleRateCode == 14) {
+		position += 2;
+	}
+	if(position + 1 > length || crc8(data, position) != data[position]) {
+		return false;
+	}
+	header->length = position + 1;
+	return true;
+}
+
+bool renumberFrame(const FLAC__byte * frame, size_t length, bool variableBlocksize, FLAC__uint64 number, std::vector<FLAC__byte> & out) {
+	FrameHeader header;
+	if(!parseFrameHeader(frame, length, &header) || length < header.length + 2) {
+		return false;
+	}
+	size_t start = out.size();
+	out.push_back(0xFF);
+	out.push_back(variableBlocksize ? 0xF9 : 0xF8);
+	out.push_back(frame[2]);
+	out.push_back(frame[3]);
+	appendCodedNumber(out, number);
+	unsigned extraStart = header.numberOffset + header.numberLength;
+	out.insert(out.end(), frame + extraStart, frame + header.length - 1);
+	out.push_back(crc8(&out[start], out.size() - start));
+	out.insert(out.end(), frame + header.length, frame + length - 2);
+	FLAC__uint16 crc = crc16(&out[start], out.size() - start);
+	out.push_back((FLAC__byte) (crc >> 8));
+	out.push_back((FLAC__byte) crc);
+	return true;
+}
+
+static void appendBigEndian(std::vector<FLAC__byte> & out, FLAC__uint64 value, unsigned bytes) {
+	while(bytes--) {
+		out.push_back((FLAC__byte) (value >> (8 * bytes)));
+	}
+}
+
+static void appendLittleEndian32(std::vector<FLAC__byte> & out, FLAC__uint32 value) {
+	for(unsigned byte = 0; byte < 4; byte++) {
+		out.push_back((FLAC__byte) (value >> (8 * byte)));
+	}
+}
+
+void appendMetadataBlockHeader(std::vector<FLAC__byte> & out, FLAC__MetadataType type, bool isLast, unsigned length) {
+	out.push_back((FLAC__byte) ((isLast ? 0x80 : 0x00) | type));
+	appendBigEndian(out, length, 3);
+}
+
+void appendStreamInfo(std::vector<FLAC__byte> & out, const FLAC__StreamMetadata_StreamInfo & streamInfo, bool isLast) {
+	appendMetadataBlockHeader(out, FLAC__METADATA_TYPE_STREAMINFO, isLast, FLACFORMAT_STREAMINFO_LENGTH);
+	appendBigEndian(out, streamInfo.min_blocksize, 2);
+	appendBigEndian(out, streamInfo.max_blocksize, 2);
+	appendBigEndian(out, streamInfo.min_framesize, 3);
+	appendBigEndian(out, streamInfo.max_framesize, 3);
+	// 20 bits of sample rate, 3 bits of channels - 1, 5 bits of bits per sample - 1, 36 bits of total samples
+	FLAC__uint64 packed = (FLAC__uint64) streamInfo.sample_rate << 44;
+	packed |= (FLAC__uint64) (streamInfo.channels - 1) << 41;
+	packed |= (FLAC__uint64) (streamInfo.bits_per_sample - 1) << 36;
+	packed |= streamInfo.total_samples & 0xFFFFFFFFFULL;
+	appendBigEndian(out, packed, 8);
+	out.insert(out.end(), streamInfo.md5sum, streamInfo.md5sum + 16);
+}
+
+void appendSeekTable(std::vector<FLAC__byte> & out, const FLAC__StreamMetadata_SeekTable & seekTable, bool isLast) {
+	appendMetadataBlockHeader(out, FLAC__METADATA_TYPE_SEEKTABLE, isLast, seekTable.num_points * FLACFORMAT_SEEKPOINT_LENGTH);
+	for(unsigned i = 0; i < seekTable.num_points; i++) {
+		appendBigEndian(out, seekTable.points[i].sample_number, 8);
+		appendBigEndian(out, seekTable.points[i].stream_offset, 8);
+		appendBigEndian(out, seekTable.points[i].frame_samples, 2);
+	}
+}
+
+void appendVorbisComment(std::vector<FLAC__byte> & out, const FLAC__StreamMetadata_VorbisComment & vorbisComment, bool isLast) {
+	size_t vendorLength = strlen(FLAC__VENDOR_STRING);
+	unsigned length = 8 + vendorLength;
+	for(FLAC__uint32 i = 0; i < vorbisComment.num_comments; i++) {
+		length += 4 + vorbisComment.comments[i].length;
+	}
+	appendMetadataBlockHeader(out, FLAC__METADATA_TYPE_VORBIS_COMMENT, isLast, length);
+	// Like the libFLAC encoder, always use our own vendor string rather than the original one
+	appendLittleEndian32(out, vendorLength);
+	out.insert(out.end(), FLAC__VENDOR_STRING, FLAC__VENDOR_STRING + vendorLength);
+	appendLittleEndian32(out, vorbisComment.num_comments);
+	for(FLAC__uint32 i = 0; i < vorbisComment.num_comments; i++) {
+		appendLittleEndian32(out, vorbisComment.comments[i].length);
+		out.insert(out.end(), vorbisComment.comments[i].entry, vorbisComment.comments[i].entry + vorbisComment.comments[i].length);
+	}
+}
+
+bool appendMetadataBlock(std::vector<FLAC__byte> & out, const FLAC__StreamMetadata * metadata, bool isLast) {
+	switch(metadata->type) {
+		case FLAC__METADATA_TYPE_STREAMINFO:
+			appendStreamInfo(out, metadata->data.stream_info, isLast);
+			return true;
+		case FLAC__METADATA_TYPE_SEEKTABLE:
+			appendSeekTable(out, metadata->data.seek_table, isLast);
+			return true;
+		case FLAC__METADATA_TYPE_VORBIS_COMMENT:
+			appendVorbisComment(out, metadata->data.vorbis_comment, isLast);
+			return true;
+		default:
+			return false;
+	}
+}
+
+}
@@ -0,0 +1,61 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef FLACFORMAT_H
+#define FLACFORMAT_H
+
+#include "FLAC/format.h"
+#include <vector>
+
+// Bitstream-level helpers for the parts of the FLAC format that libFLAC does not expose:
+// frame header parsing and renumbering, and metadata block serialization.
+// See http://flac.sourceforge.net/format.html
+namespace FLACFormat {
+	struct FrameHeader {
+		bool variableBlocksize;
+		FLAC__uint64 number; // Frame number for fixed-blocksize streams, sample number otherwise
+		unsigned blocksize;
+		unsigned numberOffset; // Offset of the UTF-8 coded number within the header
+		unsigned numberLength;
+		unsigned length; // Header length, including the CRC-8
+	};
+	FLAC__byte crc8(const FLAC__byte * data, size_t length);
+	FLAC__uint16 crc16(const FLAC__byte * data, size_t length, FLAC__uint16 crc = 0);
+	// Parses and CRC-checks the frame header at the start of data
+	bool parseFrameHeader(const FLAC__byte * data, size_t length, FrameHeader * header);
+	// Appends a copy of the given frame to out, with its number (and blocking strategy) replaced and both CRCs recomputed
+	bool renumberFrame(const FLAC__byte * frame, size_t length, bool variableBlocksize, FLAC__uint64 number, std::vector<FLAC__byte> & out);
+	// Metadata blocks, header included
+	void appendMetadataBlockHeader(std::vector<FLAC__byte> & out, FLAC__MetadataType type, bool isLast, unsigned length);
+	void appendStreamInfo(std::vector<FLAC__byte> & out, const FLAC__StreamMetadata_StreamInfo & streamInfo, bool isLast);
+	void appendSeekTable(std::vector<FLAC__byte> & out, const FLAC__StreamMetadata_SeekTable & seekTable, bool isLast);
+	void appendVorbisComment(std::vector<FLAC__byte> & out, const FLAC__StreamMetadata_VorbisComment & vorbisComment, bool isLast);
+	bool appendMetadataBlock(std::vector<FLAC__byte> & out, const FLAC__StreamMetadata * metadata, bool isLast);
+}
+
+#endif // FLACFORMAT_H
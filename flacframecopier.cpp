@@ -0,0 +1,129 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "flacframecopier.h"
+#include "flacscrubber.h"
+#include "flacstreamwriter.h"
+#include "flacformat.h"
+#include "md5.h"
+
+FLACFrameCopier::FLACFrameCopier(FLACScrubber * scrubber) : FLACMappedDecoder(), aScrubber(scrubber) {
+	FLAC__StreamDecoderInitStatus init_status = init(aScrubber->aOriginalFile);
+	error(init_status == FLAC__STREAM_DECODER_INIT_STATUS_OK, "Cannot initialize frame copy decoder: " + std::string(FLAC__StreamDecoderInitStatusString[init_status]));
+}
+
+bool FLACFrameCopier::hasError() {
+	return !aError.empty();
+}
+
+std::string FLACFrameCopier::getError() {
+	return aError;
+}
+
+void FLACFrameCopier::error(std::string errorMessage) {
+	aError = errorMessage;
+}
+
+void FLACFrameCopier::error(bool condition, std::string errorMessage) {
+	if(!condition && !hasError()) {
+		error(errorMessage);
+	}
+}
+
+void FLACFrameCopier::copyFrames(FLAC__uint64 firstSample, FLAC__uint64 endSample, FLACStreamWriter * writer, MD5 * originalMD5, MD5 * scrubbedMD5) {
+	aFirstSample = firstSample;
+	aEndSample = endSample;
+	aNextSample = firstSample;
+	aWriter = writer;
+	aOriginalMD5 = originalMD5;
+	aScrubbedMD5 = scrubbedMD5;
+	aNextFrame = aScrubber->aFrameIndex.findFrame(firstSample);
+	if(hasError()) {
+		return;
+	}
+	// Frames are located by the decoder's byte position, so walk them in order from the first one
+	error(process_until_end_of_metadata(), "Could not process metadata for copying frames.");
+	error(get_decode_position(&aFramePosition), "Cannot locate the first frame.");
+	while(!hasError() && aNextSample < aEndSample) {
+		error(get_state() != FLAC__STREAM_DECODER_END_OF_STREAM, "Unexpected end of stream.");
+		error(process_single(), "Could not process frame to copy.");
+	}
+	finish();
+}
+
+bool FLACFrameCopier::copyFrame(FLAC__uint64 position, FLAC__uint64 firstSample, unsigned blocksize) {
+	FLACFrameIndex & frameIndex = aScrubber->aFrameIndex;
+	if(aNextFrame >= frameIndex.getNumFrames()) {
+		return false;
+	}
+	const FLACFrameIndex::Frame & frame = frameIndex.getFrame(aNextFrame);
+	FLAC__uint64 frameEnd = frameIndex.getFrameEnd(aNextFrame);
+	aNextFrame++;
+	// The index was built without decoding, so make sure it agrees with the decoder
+	if(frame.offset != position || frameEnd != aFramePosition || frame.firstSample != firstSample || frame.blocksize != blocksize) {
+		return false;
+	}
+	// Both ends of the splice use the original block size, so the frame keeps its number; rewriting it still re-checks the header
+	aRenumberedFrame.clear();
+	if(!FLACFormat::renumberFrame(aMappedFile.data() + frame.offset, frameEnd - frame.offset, false, firstSample / aScrubber->aOutputBlockSize, aRenumberedFrame)) {
+		return false;
+	}
+	return aWriter->appendFrame(aRenumberedFrame.data(), aRenumberedFrame.size(), firstSample, blocksize);
+}
+
+FLAC__StreamDecoderWriteStatus FLACFrameCopier::write_callback(const FLAC__Frame * frame, const FLAC__int32 * const buffer[]) {
+	// Inside the write callback, the decode position is right after the frame just decoded
+	FLAC__uint64 frameStart = aFramePosition;
+	error(get_decode_position(&aFramePosition), "Cannot locate frame.");
+	FLAC__uint64 frameFirstSample = frame->header.number.sample_number;
+	unsigned blocksize = frame->header.blocksize;
+	if(hasError()) {
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	}
+	if(frameFirstSample + blocksize <= aFirstSample) {
+		// Still before the range to copy
+		return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+	}
+	error(frameFirstSample == aNextSample && frameFirstSample + blocksize <= aEndSample, "Frame does not line up with the splice points.");
+	if(!hasError()) {
+		error(copyFrame(frameStart, frameFirstSample, blocksize), "Could not copy frame.");
+	}
+	if(hasError()) {
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	}
+	// The samples of copied frames are left untouched, so both signatures get the same data
+	unsigned bytesPerSample = (aScrubber->aStreamInfo.bits_per_sample + 7) / 8;
+	aOriginalMD5->updatePlanarSamples(buffer, frame->header.channels, blocksize, bytesPerSample);
+	aScrubbedMD5->updatePlanarSamples(buffer, frame->header.channels, blocksize, bytesPerSample);
+	aNextSample = frameFirstSample + blocksize;
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+void FLACFrameCopier::error_callback(FLAC__StreamDecoderErrorStatus status) {
+	error(FLAC__StreamDecoderErrorStatusString[status]);
+}
@@ -0,0 +1,73 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef FLACFRAMECOPIER_H
+#define FLACFRAMECOPIER_H
+
+#include "FLAC++/decoder.h"
+#include <string>
+#include <vector>
+#include "flacmappeddecoder.h"
+
+class FLACScrubber;
+class FLACStreamWriter;
+class MD5;
+
+// Copies a range of frames of a file to a FLACStreamWriter without re-encoding them, for splice mode.
+// The frames are located with the scrubber's frame index and taken from the memory mapping. They are still decoded,
+// which checks their CRCs and the index and provides their samples for the MD5 signatures;
+// only their headers and CRCs are rewritten.
+class FLACFrameCopier : public FLACMappedDecoder
+{
+	public:
+		FLACFrameCopier(FLACScrubber * scrubber);
+		bool hasError();
+		std::string getError();
+		// Both sample numbers must be on frame boundaries of the original file
+		void copyFrames(FLAC__uint64 firstSample, FLAC__uint64 endSample, FLACStreamWriter * writer, MD5 * originalMD5, MD5 * scrubbedMD5);
+	protected:
+		virtual FLAC__StreamDecoderWriteStatus write_callback(const FLAC__Frame * frame, const FLAC__int32 * const buffer[]);
+		virtual void error_callback(FLAC__StreamDecoderErrorStatus status);
+	private:
+		FLACScrubber * aScrubber;
+		FLACStreamWriter * aWriter = nullptr;
+		MD5 * aOriginalMD5 = nullptr;
+		MD5 * aScrubbedMD5 = nullptr;
+		FLAC__uint64 aFirstSample = 0;
+		FLAC__uint64 aEndSample = 0;
+		FLAC__uint64 aNextSample = 0;
+		FLAC__uint64 aFramePosition = 0; // Byte offset of the next frame in the file
+		size_t aNextFrame = 0; // Index of the next frame in the frame index
+		std::vector<FLAC__byte> aRenumberedFrame;
+		std::string aError;
+		void error(std::string errorMessage);
+		void error(bool condition, std::string errorMessage);
+		bool copyFrame(FLAC__uint64 position, FLAC__uint64 firstSample, unsigned blocksize);
+};
+
+#endif // FLACFRAMECOPIER_H
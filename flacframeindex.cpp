@@ -0,0 +1,190 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "flacframeindex.h"
+#include "flacformat.h"
+
+// The shortest header, one byte of subframe and the CRC-16
+#define FLACFRAMEINDEX_MIN_FRAME_LENGTH 9
+
+// Position of the first frame sync code (0xFFF8 or 0xFFF9) in [start, end), or end if there is none.
+// This runs over every byte of the file, so it compares 64 byte pairs at a time with SSE2, which every x86-64 CPU has.
+static size_t findSyncCode(const FLAC__byte * data, size_t start, size_t end) {
+	size_t position = start;
+#ifdef __SSE2__
+	const __m128i allOnes = _mm_set1_epi8((char) 0xFF);
+	const __m128i syncMask = _mm_set1_epi8((char) 0xFE);
+	const __m128i syncByte = _mm_set1_epi8((char) 0xF8);
+	for(; position + 64 < end; position += 64) {
+		__m128i match[4];
+		for(int i = 0; i < 4; i++) {
+			__m128i first = _mm_loadu_si128((const __m128i *) (data + position + 16 * i));
+			__m128i second = _mm_loadu_si128((const __m128i *) (data + position + 16 * i + 1));
+			match[i] = _mm_and_si128(_mm_cmpeq_epi8(first, allOnes), _mm_cmpeq_epi8(_mm_and_si128(second, syncMask), syncByte));
+		}
+		// Sync codes are rare, so test all 64 positions at once and only then find which one it was
+		if(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(match[0], match[1]), _mm_or_si128(match[2], match[3])))) {
+			for(int i = 0; i < 4; i++) {
+				int mask = _mm_movemask_epi8(match[i]);
+				if(mask) {
+					return position + 16 * i + __builtin_ctz(mask);
+				}
+			}
+		}
+	}
+#endif
+	for(; position + 1 < end; position++) {
+		if(data[position] == 0xFF && (data[position + 1] & 0xFE) == 0xF8) {
+			return position;
+		}
+	}
+	return end;
+}
+
+FLACFrameIndex::FLACFrameIndex() {
+}
+
+bool FLACFrameIndex::build(const FLAC__byte * data, size_t size, size_t firstFrameOffset, FLAC__uint64 totalSamples) {
+	aFrames.clear();
+	aEndOffset = size;
+	FLAC__uint64 nextSample = 0;
+	FLAC__uint64 nextNumber = 0;
+	unsigned nominalBlocksize = 0;
+	size_t position = firstFrameOffset;
+	while(totalSamples == 0 || nextSample < totalSamples) {
+		position = findSyncCode(data, position, size);
+		if(position == size) {
+			break;
+		}
+		FLACFormat::FrameHeader header;
+		if(!FLACFormat::parseFrameHeader(data + position, size - position, &header)) {
+			position++;
+			continue;
+		}
+		if(aFrames.empty()) {
+			// The first frame decides the blocking strategy, and fixed-blocksize frame numbers count in its block size
+			aVariableBlocksize = header.variableBlocksize;
+			nominalBlocksize = header.blocksize;
+		}
+		if(header.variableBlocksize != aVariableBlocksize || header.number != (aVariableBlocksize ? nextSample : nextNumber)) {
+			position++;
+			continue;
+		}
+		Frame frame;
+		frame.offset = position;
+		frame.firstSample = aVariableBlocksize ? header.number : header.number * nominalBlocksize;
+		frame.blocksize = header.blocksize;
+		aFrames.push_back(frame);
+		nextSample = frame.firstSample + frame.blocksize;
+		nextNumber++;
+		// The next frame cannot start before the end of this header, one byte of subframe and the CRC-16
+		position += header.length + 3;
+	}
+	if(aFrames.empty() || (totalSamples != 0 && nextSample != totalSamples)) {
+		return false;
+	}
+	// Nothing marks the end of the last frame but its CRC-16, which makes the CRC of the whole frame, footer included, zero
+	size_t start = aFrames.back().offset;
+	if(size - start < FLACFRAMEINDEX_MIN_FRAME_LENGTH) {
+		return false;
+	}
+	FLAC__uint16 crc = FLACFormat::crc16(data + start, FLACFRAMEINDEX_MIN_FRAME_LENGTH - 1);
+	aEndOffset = 0;
+	for(size_t end = start + FLACFRAMEINDEX_MIN_FRAME_LENGTH; end <= size; end++) {
+		crc = FLACFormat::crc16(data + end - 1, 1, crc);
+		if(crc == 0) {
+			aEndOffset = end;
+		}
+	}
+	// Without any match, the last frame is truncated
+	return aEndOffset != 0;
+}
+
+size_t FLACFrameIndex::getNumFrames() {
+	return aFrames.size();
+}
+
+const FLACFrameIndex::Frame & FLACFrameIndex::getFrame(size_t index) {
+	return aFrames[index];
+}
+
+FLAC__uint64 FLACFrameIndex::getFrameEnd(size_t index) {
+	return index + 1 < aFrames.size() ? aFrames[index + 1].offset : aEndOffset;
+}
+
+bool FLACFrameIndex::setLastFrameEnd(FLAC__uint64 offset) {
+	if(aFrames.empty() || offset <= aFrames.back().offset || offset > aEndOffset) {
+		return false;
+	}
+	aEndOffset = offset;
+	return true;
+}
+
+void FLACFrameIndex::reset(FLAC__uint64 firstFrameOffset) {
+	aFrames.clear();
+	aEndOffset = firstFrameOffset;
+}
+
+bool FLACFrameIndex::appendFrame(FLAC__uint64 firstSample, unsigned blocksize, FLAC__uint64 end) {
+	FLAC__uint64 nextSample = aFrames.empty() ? 0 : aFrames.back().firstSample + aFrames.back().blocksize;
+	if(firstSample != nextSample || end <= aEndOffset) {
+		return false;
+	}
+	Frame frame;
+	frame.offset = aEndOffset;
+	frame.firstSample = firstSample;
+	frame.blocksize = blocksize;
+	aFrames.push_back(frame);
+	aEndOffset = end;
+	return true;
+}
+
+size_t FLACFrameIndex::findFrame(FLAC__uint64 sample) {
+	// Frames are sorted by first sample
+	size_t low = 0;
+	size_t high = aFrames.size();
+	while(low < high) {
+		size_t middle = low + (high - low) / 2;
+		if(aFrames[middle].firstSample + aFrames[middle].blocksize <= sample) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	if(low < aFrames.size() && aFrames[low].firstSample <= sample) {
+		return low;
+	}
+	return aFrames.size();
+}
+
+bool FLACFrameIndex::isVariableBlocksize() {
+	return aVariableBlocksize;
+}
@@ -0,0 +1,74 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef FLACFRAMEINDEX_H
+#define FLACFRAMEINDEX_H
+
+#include "FLAC/format.h"
+#include <vector>
+
+// Where each frame of a FLAC stream starts, found by scanning the raw bytes for frame headers
+// instead of decoding. A sync code only counts as a frame if its header passes the CRC-8 check
+// and carries the number that the previous frame leads to, which rules out sync codes that
+// happen to appear inside frame data.
+class FLACFrameIndex
+{
+	public:
+		struct Frame {
+			FLAC__uint64 offset;
+			FLAC__uint64 firstSample;
+			unsigned blocksize;
+		};
+		FLACFrameIndex();
+		// data holds the whole file and the first frame starts at firstFrameOffset.
+		// Fails unless the frames found cover totalSamples samples, when it is known (not 0).
+		bool build(const FLAC__byte * data, size_t size, size_t firstFrameOffset, FLAC__uint64 totalSamples);
+		size_t getNumFrames();
+		const Frame & getFrame(size_t index);
+		// Offset just past the frame, which is where the next one starts. For the last frame, it is the last offset
+		// at which the frame's CRC-16 checks out: anything appended to the stream (ID3v1 or APE tags...) is left out,
+		// but it is only an upper bound, since such data may happen to complete a matching CRC. Callers that copy the
+		// last frame's bytes must confirm its end by decoding it, see setLastFrameEnd.
+		FLAC__uint64 getFrameEnd(size_t index);
+		// Narrows the end of the last frame to where the decoder found it; fails unless that is within the frame
+		bool setLastFrameEnd(FLAC__uint64 offset);
+		// Starts over with an index that the caller fills in from where a decoder finds each frame, which is exact
+		// but much slower than build; the first frame starts at firstFrameOffset
+		void reset(FLAC__uint64 firstFrameOffset);
+		// Adds the frame that follows the last one, and ends at end
+		bool appendFrame(FLAC__uint64 firstSample, unsigned blocksize, FLAC__uint64 end);
+		// Index of the frame containing sample, or getNumFrames() if there is none
+		size_t findFrame(FLAC__uint64 sample);
+		bool isVariableBlocksize();
+	private:
+		std::vector<Frame> aFrames;
+		FLAC__uint64 aEndOffset = 0;
+		bool aVariableBlocksize = false;
+};
+
+#endif // FLACFRAMEINDEX_H
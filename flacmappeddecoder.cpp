@@ -0,0 +1,122 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include "flacmappeddecoder.h"
+
+FLACMappedDecoder::FLACMappedDecoder() : FLAC::Decoder::Stream() {
+}
+
+FLACMappedDecoder::~FLACMappedDecoder() {
+}
+
+FLAC__StreamDecoderInitStatus FLACMappedDecoder::init(std::string file) {
+	if(!aMappedFile.open(file)) {
+		return FLAC__STREAM_DECODER_INIT_STATUS_ERROR_OPENING_FILE;
+	}
+	// Decoders mostly read straight through, so let the kernel read ahead and drop pages behind
+	aMappedFile.adviseSequential();
+	aPosition = 0;
+	aStreamDescriptor = -1;
+	return FLAC::Decoder::Stream::init();
+}
+
+FLAC__StreamDecoderInitStatus FLACMappedDecoder::initStream(int descriptor) {
+	aMappedFile.close();
+	aPosition = 0;
+	aStreamDescriptor = descriptor;
+	aStreamEnded = false;
+	return FLAC::Decoder::Stream::init();
+}
+
+bool FLACMappedDecoder::finish() {
+	bool finished = FLAC::Decoder::Stream::finish();
+	aMappedFile.close();
+	aStreamDescriptor = -1;
+	return finished;
+}
+
+FLAC__StreamDecoderReadStatus FLACMappedDecoder::read_callback(FLAC__byte buffer[], size_t * bytes) {
+	if(aStreamDescriptor != -1) {
+		ssize_t count;
+		do {
+			count = read(aStreamDescriptor, buffer, *bytes);
+		} while(count < 0 && errno == EINTR);
+		if(count < 0) {
+			*bytes = 0;
+			return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+		}
+		*bytes = (size_t) count;
+		aPosition += *bytes;
+		aStreamEnded = count == 0;
+		return aStreamEnded ? FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM : FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+	}
+	if(aPosition >= aMappedFile.size()) {
+		*bytes = 0;
+		return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+	}
+	if(*bytes > aMappedFile.size() - aPosition) {
+		*bytes = aMappedFile.size() - aPosition;
+	}
+	memcpy(buffer, aMappedFile.data() + aPosition, *bytes);
+	aPosition += *bytes;
+	return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+}
+
+FLAC__StreamDecoderSeekStatus FLACMappedDecoder::seek_callback(FLAC__uint64 absolute_byte_offset) {
+	if(aStreamDescriptor != -1) {
+		return FLAC__STREAM_DECODER_SEEK_STATUS_UNSUPPORTED;
+	}
+	if(absolute_byte_offset > aMappedFile.size()) {
+		return FLAC__STREAM_DECODER_SEEK_STATUS_ERROR;
+	}
+	aPosition = (size_t) absolute_byte_offset;
+	return FLAC__STREAM_DECODER_SEEK_STATUS_OK;
+}
+
+FLAC__StreamDecoderTellStatus FLACMappedDecoder::tell_callback(FLAC__uint64 * absolute_byte_offset) {
+	*absolute_byte_offset = aPosition;
+	return FLAC__STREAM_DECODER_TELL_STATUS_OK;
+}
+
+FLAC__StreamDecoderLengthStatus FLACMappedDecoder::length_callback(FLAC__uint64 * stream_length) {
+	if(aStreamDescriptor != -1) {
+		return FLAC__STREAM_DECODER_LENGTH_STATUS_UNSUPPORTED;
+	}
+	*stream_length = aMappedFile.size();
+	return FLAC__STREAM_DECODER_LENGTH_STATUS_OK;
+}
+
+bool FLACMappedDecoder::eof_callback() {
+	if(aStreamDescriptor != -1) {
+		return aStreamEnded;
+	}
+	return aPosition >= aMappedFile.size();
+}
@@ -0,0 +1,61 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef FLACMAPPEDDECODER_H
+#define FLACMAPPEDDECODER_H
+
+#include "FLAC++/decoder.h"
+#include <string>
+#include "mappedfile.h"
+
+// A FLAC stream decoder that reads its input from a memory mapping of the file instead of stdio.
+// The mapping is available to subclasses, which lets them look at the raw bytes of the stream
+// without opening the file a second time. Input that cannot be mapped, such as a pipe, is read
+// straight from its descriptor instead; such streams cannot seek and have no mapping.
+class FLACMappedDecoder : public FLAC::Decoder::Stream
+{
+	public:
+		FLACMappedDecoder();
+		virtual ~FLACMappedDecoder();
+		FLAC__StreamDecoderInitStatus init(std::string file);
+		FLAC__StreamDecoderInitStatus initStream(int descriptor);
+		virtual bool finish();
+	protected:
+		MappedFile aMappedFile;
+		virtual FLAC__StreamDecoderReadStatus read_callback(FLAC__byte buffer[], size_t * bytes);
+		virtual FLAC__StreamDecoderSeekStatus seek_callback(FLAC__uint64 absolute_byte_offset);
+		virtual FLAC__StreamDecoderTellStatus tell_callback(FLAC__uint64 * absolute_byte_offset);
+		virtual FLAC__StreamDecoderLengthStatus length_callback(FLAC__uint64 * stream_length);
+		virtual bool eof_callback();
+	private:
+		size_t aPosition = 0;
+		int aStreamDescriptor = -1;
+		bool aStreamEnded = false;
+};
+
+#endif // FLACMAPPEDDECODER_H
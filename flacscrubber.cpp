@@ -32,30 +32,35 @@
 #include <algorithm>
 #include <string.h>
 #include <math.h>
+#include <unistd.h>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
 #include "flacscrubber.h"
+#include "flacsegmentscrubber.h"
+#include "flacframecopier.h"
+#include "flacformat.h"
+#include "flacstreamwriter.h"
+#include "md5.h"
+#include "scrubstamp.h"
+#include "scrubcheckpoint.h"
 
-FLACScrubber::FLACScrubber(std::string file) : FLAC::Decoder::File(), aOriginalFile(file) {
-	aError = "";
-	aScrubbedFile = file + ".scrubbing";
+FLACScrubber::FLACScrubber(std::string file) : FLACMappedDecoder(), aFreeFrames(FLACSCRUBBER_PIPELINE_FRAMES), aDecodedFrames(FLACSCRUBBER_PIPELINE_FRAMES + 1), aScrubbedFrames(FLACSCRUBBER_PIPELINE_FRAMES + 1), aPipelineFailed(false), aOriginalFile(file), aReporter(file) {
+	aStreaming = file == FLACSCRUBBER_STREAM_FILE;
+	aScrubbedFile = aStreaming ? file : file + FLACSCRUBBER_SCRUBBING_SUFFIX;
 	error(aEncoder.set_verify(true), "Cannot set verification on the encoder.");
 	error(aEncoder.set_compression_level(8), "Cannot enable compression on the encoder.");
 	error(set_md5_checking(true), "Cannot enable MD5 checking on the decoder.");
 	error(set_metadata_respond_all(), "Cannot listen to all metadata on the decoder.");
-	FLAC__StreamDecoderInitStatus init_status = init(aOriginalFile);
+	FLAC__StreamDecoderInitStatus init_status = aStreaming ? initStream(STDIN_FILENO) : init(aOriginalFile);
 	error(init_status == FLAC__STREAM_DECODER_INIT_STATUS_OK, "Cannot initialize decoder: " + std::string(FLAC__StreamDecoderInitStatusString[init_status]));
-	aAllowedTags = new std::vector<std::string>();
-	std::string allowedTags(FLACSCRUBBER_DEFAULT_ALLOWEDTAGS);
-	std::transform(allowedTags.begin(), allowedTags.end(), allowedTags.begin(), tolower);
-	std::stringstream tempStream(allowedTags);
-	std::string item;
-	while(std::getline(tempStream, item, ',')) {
-		aAllowedTags->push_back(item);
-	}
+	aAllowedTags.assign(TagWhitelist::split(FLACSCRUBBER_DEFAULT_ALLOWEDTAGS));
 }
 
 FLACScrubber::~FLACScrubber()
 {
-	delete aAllowedTags;
 	if(aTags != nullptr) {
 		FLAC__metadata_object_delete(aTags);
 	}
@@ -65,136 +70,548 @@ FLACScrubber::~FLACScrubber()
 	delete [] aMetadata;
 }
 
-void FLACScrubber::setForceNonZero(bool forceNonZero) {
-	aForceNonZero = forceNonZero;
+ScrubEngine & FLACScrubber::getEngine() {
+	return aEngine;
 }
 
-void FLACScrubber::scrubFirstSamples(int maxOffset) {
-	aFirstSamplesMaxOffset = maxOffset;
+void FLACScrubber::setAllowedTags(std::vector<std::string> * allowedTags) {
+	aAllowedTags.assign(*allowedTags);
+	aAllowedTagsList = getAllowedTagsList(allowedTags);
 }
 
-void FLACScrubber::scrubLastSamples(int maxOffset) {
-	aLastSamplesMaxOffset = maxOffset;
+void FLACScrubber::setSegmentJobs(int jobs) {
+	aSegmentJobs = jobs;
 }
 
-void FLACScrubber::scrubOtherSamples(int maxOffset) {
-	aOtherSamplesMaxOffset = maxOffset;
+void FLACScrubber::setPipelined(bool pipelined) {
+	aPipelined = pipelined;
 }
 
-void FLACScrubber::setFirstSamplesSize(int samples) {
-	aFirstSamplesSize = samples;
+void FLACScrubber::setSplice(bool splice) {
+	aSplice = splice;
 }
 
-void FLACScrubber::setLastSamplesSize(int samples) {
-	aLastSamplesSize = samples;
+void FLACScrubber::setSync(FLACScrubberSync sync) {
+	aSync = sync;
 }
-void FLACScrubber::setFirstSamplesScrubRate(float rate) {
-	aFirstSamplesScrubRate = rate;
+
+void FLACScrubber::setTagsOnly(bool tagsOnly) {
+	aTagsOnly = tagsOnly;
 }
 
-void FLACScrubber::setLastSamplesScrubRate(float rate) {
-	aLastSamplesScrubRate = rate;
+void FLACScrubber::setCheckpointInterval(int seconds) {
+	aCheckpointInterval = seconds;
 }
 
-void FLACScrubber::setOtherSamplesScrubRate(float rate) {
-	aOtherSamplesScrubRate = rate;
+bool FLACScrubber::isScrubbed(std::string file, std::string stampParameters) {
+	return file != FLACSCRUBBER_STREAM_FILE && ScrubStamp(stampParameters).matches(file);
 }
 
-void FLACScrubber::setAllowedTags(std::vector<std::string> * allowedTags) {
-	aAllowedTags->clear();
+std::string FLACScrubber::getStampParameters(ScrubEngine & engine, bool tagsOnly, bool splice, std::string allowedTagsList) {
+	std::ostringstream parameters;
+	parameters << engine.getParameters() << ";tagsonly=" << tagsOnly << ";splice=" << splice << ";tags=" << allowedTagsList;
+	// A random seed gives a different output every time, so any earlier random run is as good as a new one
+	parameters << ";" << engine.getSeedParameter();
+	return parameters.str();
+}
+
+std::string FLACScrubber::getAllowedTagsList(std::vector<std::string> * allowedTags) {
+	if(allowedTags == nullptr) {
+		return FLACSCRUBBER_DEFAULT_ALLOWEDTAGS;
+	}
+	std::string list;
 	for(std::vector<std::string>::iterator it = allowedTags->begin(); it != allowedTags->end(); it++) {
-		std::string lowercaseTag = *it;
-		std::transform(lowercaseTag.begin(), lowercaseTag.end(), lowercaseTag.begin(), tolower);
-		aAllowedTags->push_back(lowercaseTag);
+		list += (it == allowedTags->begin() ? "" : ",") + *it;
 	}
+	return list;
+}
+
+std::string FLACScrubber::getStampParameters() {
+	return getStampParameters(aEngine, aTagsOnly, aSplice, aAllowedTagsList);
 }
 
 void FLACScrubber::processEverything(bool showProgress) {
-	aShowProgress = showProgress;
+	aReporter.setShowProgress(showProgress);
 	if(hasError()) {
 		return;
 	}
-	error(process_until_end_of_stream(), "Could not process stream.");
+	// Read STREAMINFO first, so that the scrub kernels and buffers are ready before any audio comes in
+	error(process_until_end_of_metadata(), "Could not process metadata.");
 	if(hasError()) {
 		return;
 	}
-	error(finish(), "Could not finish the decoding process.");
-	error(aEncoder.finish(), "Could not finish the encoding process.");
+	// Splicing and segments need to seek in both files, which streams cannot do
+	// Checkpoints are taken between segments, so they rule out splicing
+	bool splice = aSplice && !aTagsOnly && !aStreaming && aCheckpointInterval == 0 && canSplice();
+	if(aTagsOnly) {
+		processTagsOnly();
+		// As with splicing, no audio went through this decoder
+		finish();
+	} else if(splice || (!aStreaming && (aSegmentJobs > 1 || aCheckpointInterval > 0) && aTotalSamples > FLACSCRUBBER_SEGMENT_SAMPLES)) {
+		if(splice) {
+			processSplice();
+		} else {
+			processSegments();
+		}
+		// No audio went through this decoder, so its own MD5 check is meaningless; processSplice or processSegments did it instead
+		finish();
+	} else {
+		if(aPipelined) {
+			startPipeline();
+		} else if(aDelayFrames) {
+			prepareFrames(aDelayFrames);
+		}
+		error(process_until_end_of_stream(), "Could not process stream.");
+		if(aPipelined) {
+			stopPipeline();
+		} else if(!hasError()) {
+			endDelayLine();
+			flushDelayedFrames();
+		}
+		if(hasError()) {
+			return;
+		}
+		// Only now is the length of a stream that did not announce it known
+		if(aTotalSamples <= 0) {
+			aTotalSamples = aDecodedSamples;
+		}
+		error(finish(), "Could not finish the decoding process.");
+		error(aEncoder.finish(), "Could not finish the encoding process.");
+	}
 	if(hasError()) {
 		return;
 	}
-	this->showProgress(aTotalSamples);
-	std::cerr << std::endl;
+	aReporter.finishProgress(aTotalSamples);
 }
 
 void FLACScrubber::cancel() {
-	std::remove(aScrubbedFile.c_str());
+	if(!aStreaming) {
+		std::remove(aScrubbedFile.c_str());
+		// Only an interruption leaves a checkpoint behind, not a failure
+		std::remove(ScrubCheckpoint::getPath(aOriginalFile).c_str());
+	}
 }
 
 void FLACScrubber::overwrite() {
-	error(std::remove(aOriginalFile.c_str()) == 0, "Could not delete original file.");
+	if(aStreaming) {
+		return;
+	}
+	// Best effort: without user attributes, the file is simply scrubbed again next time
+	ScrubStamp(getStampParameters()).write(aScrubbedFile);
+	error(AsyncFileWriter::replace(aScrubbedFile, aOriginalFile, aSync == FLACSCRUBBER_SYNC_FILE), "Could not replace the original file by the scrubbed version.");
+}
+
+void FLACScrubber::processSegments() {
+	unsigned numBlocks = prepareMetadata();
+	FLACStreamWriter writer;
+	writer.setSync(aSync == FLACSCRUBBER_SYNC_FILE);
+	// Segments are scrubbed in any order, but committed to the file (and the MD5 signatures) strictly in order
+	MD5 originalMD5;
+	MD5 scrubbedMD5;
+	ScrubCheckpoint checkpoint(aOriginalFile, getStampParameters());
+	unsigned firstSegment = 0;
+	if(aCheckpointInterval > 0) {
+		writer.setNamed(true);
+		firstSegment = resumeSegments(&checkpoint, &writer, numBlocks, &originalMD5, &scrubbedMD5);
+	}
+	if(firstSegment == 0) {
+		error(writer.open(aScrubbedFile, aStreamInfo, aMetadata, numBlocks), "Cannot open the scrubbed file for writing.");
+	}
+	if(hasError()) {
+		return;
+	}
+	unsigned numSegments = (aTotalSamples + FLACSCRUBBER_SEGMENT_SAMPLES - 1) / FLACSCRUBBER_SEGMENT_SAMPLES;
+	std::atomic<unsigned> nextSegment(firstSegment);
+	std::atomic<bool> failed(false);
+	unsigned committedSegments = firstSegment;
+	std::chrono::steady_clock::time_point nextCheckpoint = std::chrono::steady_clock::now() + std::chrono::seconds(aCheckpointInterval);
+	std::mutex commitMutex;
+	std::condition_variable committed;
+	auto worker = [&]() {
+		FLACSegmentScrubber segmentScrubber(this);
+		for(unsigned segment = nextSegment++; segment < numSegments && !failed; segment = nextSegment++) {
+			FLAC__uint64 firstSample = (FLAC__uint64) segment * FLACSCRUBBER_SEGMENT_SAMPLES;
+			segmentScrubber.scrubSegment(firstSample, std::min(firstSample + FLACSCRUBBER_SEGMENT_SAMPLES, (FLAC__uint64) aTotalSamples));
+			std::unique_lock<std::mutex> lock(commitMutex);
+			committed.wait(lock, [&]() { return failed || committedSegments == segment; });
+			if(!failed) {
+				commitSegment(&segmentScrubber, &writer, &originalMD5, &scrubbedMD5);
+				failed = hasError();
+				if(!failed) {
+					committedSegments++;
+				}
+			}
+			// The commit lock keeps the file and the MD5 signatures still while they are saved
+			if(!failed && aCheckpointInterval > 0 && committedSegments < numSegments && std::chrono::steady_clock::now() >= nextCheckpoint) {
+				saveCheckpoint(&checkpoint, &writer, committedSegments, &originalMD5, &scrubbedMD5);
+				failed = hasError();
+				nextCheckpoint = std::chrono::steady_clock::now() + std::chrono::seconds(aCheckpointInterval);
+			}
+			committed.notify_all();
+		}
+	};
+	std::vector<std::thread> workers;
+	for(int i = 1; i < aSegmentJobs; i++) {
+		workers.push_back(std::thread(worker));
+	}
+	worker();
+	for(std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); it++) {
+		it->join();
+	}
 	if(hasError()) {
 		return;
 	}
-	error(std::rename(aScrubbedFile.c_str(), aOriginalFile.c_str()) == 0, "Could not replace the original file by the scrubbed version.");
+	finishStream(&writer, &originalMD5, &scrubbedMD5);
+	if(aCheckpointInterval > 0 && !hasError()) {
+		checkpoint.remove();
+	}
 }
 
-inline FLAC__int32 FLACScrubber::getRandomSampleInner(int maxOffset, float rate) {
-	if(!rate) {
+unsigned FLACScrubber::resumeSegments(ScrubCheckpoint * checkpoint, FLACStreamWriter * writer, unsigned numBlocks, MD5 * originalMD5, MD5 * scrubbedMD5) {
+	ScrubCheckpoint::State state;
+	std::vector<FLAC__StreamMetadata_SeekPoint> seekPoints;
+	bool resumable = checkpoint->load(&state, &seekPoints);
+	resumable = resumable && state.segments > 0 && state.writer.writtenSamples == (FLAC__uint64) state.segments * FLACSCRUBBER_SEGMENT_SAMPLES && state.writer.writtenSamples < (FLAC__uint64) aTotalSamples;
+	if(!resumable || !writer->resume(aScrubbedFile, aStreamInfo, aMetadata, numBlocks, state.writer, seekPoints)) {
+		// Whatever is left belongs to another run, which the new scrubbed file is about to replace
+		checkpoint->remove();
 		return 0;
 	}
-	if(rate != 1.f) {
-		if((float) random() / (float) RAND_MAX > rate) {
-			return 0;
+	originalMD5->setState(state.originalMD5);
+	scrubbedMD5->setState(state.scrubbedMD5);
+	// The random offsets only depend on the seed, so restoring it picks the sequence up where it was
+	aEngine.restoreSeed(state.seed);
+	showProgress(writer->getWrittenSamples());
+	return state.segments;
+}
+
+void FLACScrubber::saveCheckpoint(ScrubCheckpoint * checkpoint, FLACStreamWriter * writer, unsigned segments, MD5 * originalMD5, MD5 * scrubbedMD5) {
+	ScrubCheckpoint::State state;
+	std::vector<FLAC__StreamMetadata_SeekPoint> seekPoints;
+	// The checkpoint must never point past what actually reached the disk
+	error(writer->sync(&state.writer, &seekPoints), "Could not flush the scrubbed file to disk.");
+	if(hasError()) {
+		return;
+	}
+	state.seed = aEngine.getSeed();
+	state.segments = segments;
+	state.originalMD5 = originalMD5->getState();
+	state.scrubbedMD5 = scrubbedMD5->getState();
+	// Best effort: without a checkpoint, an interrupted run simply starts over
+	checkpoint->save(state, seekPoints);
+}
+
+bool FLACScrubber::canSplice() {
+	const ScrubKernelParameters & parameters = aEngine.getKernelParameters();
+	// Only worth it when the middle of the file comes out unchanged
+	if(parameters.otherRegion.threshold || parameters.otherRegion.constant) {
+		return false;
+	}
+	// Re-encoded frames must fit exactly in place of the original ones, so the original needs a single block size
+	unsigned blockSize = aStreamInfo.max_blocksize;
+	if(aTotalSamples <= 0 || aStreamInfo.min_blocksize != blockSize || blockSize > FLACSCRUBBER_SPLICE_MAX_BLOCKSIZE) {
+		return false;
+	}
+	aSpliceHeadEnd = std::min((FLAC__uint64) aTotalSamples, ((FLAC__uint64) parameters.firstSamplesEnd + blockSize - 1) / blockSize * blockSize);
+	aSpliceTailStart = std::max((FLAC__int64) 0, parameters.lastSamplesStart) / blockSize * blockSize;
+	if(aSpliceTailStart <= aSpliceHeadEnd) {
+		return false;
+	}
+	// Locate the frames to copy, which also tells whether they are numbered by frame or by sample
+	return buildFrameIndex() && !aFrameIndex.isVariableBlocksize();
+}
+
+bool FLACScrubber::buildFrameIndex() {
+	// Right after the metadata, the decoder is positioned on the first frame
+	FLAC__uint64 firstFrameOffset;
+	if(aStreaming || !get_decode_position(&firstFrameOffset)) {
+		return false;
+	}
+	return aFrameIndex.build(aMappedFile.data(), aMappedFile.size(), firstFrameOffset, aTotalSamples > 0 ? aTotalSamples : 0);
+}
+
+// The frame index only bounds the end of the last frame. Frames are copied byte for byte, so anything appended to
+// the stream (ID3v1 or APE tags...) would come along with it: decode that frame to find out where it really ends.
+bool FLACScrubber::locateLastFrameEnd() {
+	const FLACFrameIndex::Frame & lastFrame = aFrameIndex.getFrame(aFrameIndex.getNumFrames() - 1);
+	aLocatingLastFrame = true;
+	aLastFrameEnd = 0;
+	bool found = seek_absolute(lastFrame.firstSample);
+	aLocatingLastFrame = false;
+	return found && aFrameIndex.setLastFrameEnd(aLastFrameEnd);
+}
+
+// Seek points are filled in from the frame index, so the frames they land on must really be where the index has them.
+// A sync code and header inside frame data only pass for a frame once in a long while, and then the CRC-16 of any frame
+// that starts or ends at the false one does not check out.
+bool FLACScrubber::checkSeekFrames() {
+	if(aSeektable == nullptr) {
+		return true;
+	}
+	const FLAC__StreamMetadata_SeekTable & seekTable = aSeektable->data.seek_table;
+	unsigned point = 0;
+	for(size_t i = 0; i < aFrameIndex.getNumFrames() && point < seekTable.num_points; i++) {
+		const FLACFrameIndex::Frame & frame = aFrameIndex.getFrame(i);
+		if(seekTable.points[point].sample_number >= frame.firstSample + frame.blocksize) {
+			continue;
+		}
+		while(point < seekTable.num_points && seekTable.points[point].sample_number < frame.firstSample + frame.blocksize) {
+			point++;
+		}
+		if(FLACFormat::crc16(aMappedFile.data() + frame.offset, aFrameIndex.getFrameEnd(i) - frame.offset) != 0) {
+			return false;
 		}
 	}
-	int sign = rand() % 2 ? -1 : 1;
-	if(aForceNonZero) {
-		if(maxOffset == 0 || maxOffset == 1) {
-			return sign;
+	return true;
+}
+
+bool FLACScrubber::indexFramesByDecoding() {
+	aFrameIndex.reset(aFrameIndex.getFrame(0).offset);
+	aIndexingFrames = true;
+	// Seeking to the first sample decodes the first frame, and each process_single() the next one
+	bool success = seek_absolute(0);
+	while(success && !hasError() && aFrameIndex.getNumFrames() > 0) {
+		size_t numFrames = aFrameIndex.getNumFrames();
+		const FLACFrameIndex::Frame & lastFrame = aFrameIndex.getFrame(numFrames - 1);
+		if(lastFrame.firstSample + lastFrame.blocksize >= (FLAC__uint64) aTotalSamples) {
+			break;
 		}
-		return sign * (1 + (rand() % (maxOffset - 1)));
+		success = process_single() && aFrameIndex.getNumFrames() > numFrames;
 	}
-	if(!maxOffset) {
-		return 0;
+	aIndexingFrames = false;
+	return success && !hasError() && aFrameIndex.getNumFrames() > 0;
+}
+
+void FLACScrubber::processTagsOnly() {
+	error(buildFrameIndex(), "Cannot locate the frames of the file.");
+	if(hasError()) {
+		return;
+	}
+	error(locateLastFrameEnd(), "Cannot locate the end of the last frame.");
+	if(hasError()) {
+		return;
+	}
+	if(aTotalSamples <= 0) {
+		const FLACFrameIndex::Frame & lastFrame = aFrameIndex.getFrame(aFrameIndex.getNumFrames() - 1);
+		aTotalSamples = lastFrame.firstSample + lastFrame.blocksize;
+	}
+	// Only the whitelisted tags and a new seek table are kept; every other metadata block is dropped
+	unsigned numBlocks = prepareMetadata();
+	if(!checkSeekFrames()) {
+		// Fall back to where the decoder finds the frames, which does not depend on sync codes
+		error(indexFramesByDecoding(), "Cannot locate the frames of the file.");
+		if(hasError()) {
+			return;
+		}
+	}
+	size_t numFrames = aFrameIndex.getNumFrames();
+	FLACStreamWriter writer;
+	writer.setSync(aSync == FLACSCRUBBER_SYNC_FILE);
+	error(writer.open(aScrubbedFile, aStreamInfo, aMetadata, numBlocks), "Cannot open the scrubbed file for writing.");
+	if(hasError()) {
+		return;
 	}
-	return sign * (rand() % maxOffset);
+	// The audio is left as it is, frame numbers included, so frames go straight from the mapping to the writer
+	for(size_t i = 0; i < numFrames; i++) {
+		const FLACFrameIndex::Frame & frame = aFrameIndex.getFrame(i);
+		error(writer.appendFrame(aMappedFile.data() + frame.offset, aFrameIndex.getFrameEnd(i) - frame.offset, frame.firstSample, frame.blocksize), "Could not copy frame.");
+		if(hasError()) {
+			return;
+		}
+		showProgress(frame.firstSample + frame.blocksize);
+	}
+	error(writer.finish(aStreamInfo.md5sum), "Could not finish the scrubbed file.");
 }
 
-inline FLAC__int32 FLACScrubber::getRandomSample(int sampleNumber) {
-	if(sampleNumber <= aFirstSamplesSize) {
-		return getRandomSampleInner(aFirstSamplesMaxOffset, aFirstSamplesScrubRate);
+void FLACScrubber::processSplice() {
+	aOutputBlockSize = aStreamInfo.max_blocksize;
+	unsigned numBlocks = prepareMetadata();
+	FLACStreamWriter writer;
+	writer.setSync(aSync == FLACSCRUBBER_SYNC_FILE);
+	error(writer.open(aScrubbedFile, aStreamInfo, aMetadata, numBlocks), "Cannot open the scrubbed file for writing.");
+	if(hasError()) {
+		return;
 	}
-	if(sampleNumber >= aTotalSamples - aLastSamplesSize) {
-		return getRandomSampleInner(aLastSamplesMaxOffset, aLastSamplesScrubRate);
+	// Re-encode the frames that overlap the scrubbed head and tail, and copy the ones in between as they are
+	MD5 originalMD5;
+	MD5 scrubbedMD5;
+	FLACSegmentScrubber segmentScrubber(this);
+	segmentScrubber.scrubSegment(0, aSpliceHeadEnd);
+	commitSegment(&segmentScrubber, &writer, &originalMD5, &scrubbedMD5);
+	if(hasError()) {
+		return;
 	}
-	if(aOtherSamplesMaxOffset) {
-		return getRandomSampleInner(aOtherSamplesMaxOffset, aOtherSamplesScrubRate);
+	FLACFrameCopier frameCopier(this);
+	frameCopier.copyFrames(aSpliceHeadEnd, aSpliceTailStart, &writer, &originalMD5, &scrubbedMD5);
+	if(frameCopier.hasError()) {
+		error(frameCopier.getError());
+		return;
 	}
-	if(aForceNonZero) {
-		return 1;
+	showProgress(writer.getWrittenSamples());
+	if(aSpliceTailStart < (FLAC__uint64) aTotalSamples) {
+		segmentScrubber.scrubSegment(aSpliceTailStart, aTotalSamples);
+		commitSegment(&segmentScrubber, &writer, &originalMD5, &scrubbedMD5);
 	}
-	return 0;
+	if(hasError()) {
+		return;
+	}
+	finishStream(&writer, &originalMD5, &scrubbedMD5);
+}
+
+void FLACScrubber::commitSegment(FLACSegmentScrubber * segmentScrubber, FLACStreamWriter * writer, MD5 * originalMD5, MD5 * scrubbedMD5) {
+	if(segmentScrubber->hasError()) {
+		error(segmentScrubber->getError());
+		return;
+	}
+	error(segmentScrubber->commit(writer, originalMD5, scrubbedMD5), "Could not write segment to the scrubbed file.");
+	showProgress(writer->getWrittenSamples());
+}
+
+void FLACScrubber::finishStream(FLACStreamWriter * writer, MD5 * originalMD5, MD5 * scrubbedMD5) {
+	FLAC__byte md5sum[16];
+	static const FLAC__byte noMD5sum[16] = {0};
+	originalMD5->finish(md5sum);
+	error(memcmp(aStreamInfo.md5sum, noMD5sum, 16) == 0 || memcmp(aStreamInfo.md5sum, md5sum, 16) == 0, "MD5 signature mismatch in the original file.");
+	scrubbedMD5->finish(md5sum);
+	error(writer->finish(md5sum), "Could not finish writing the scrubbed file.");
+}
+
+void FLACScrubber::reserveBuffers(unsigned blockSize, unsigned numChannels) {
+	// Frames never exceed the maximum block size announced in STREAMINFO, so the buffers only grow on broken files
+	aScrubbedSamples.reserve(blockSize * numChannels);
+	for(std::vector<FLACScrubberFrame>::iterator it = aPipelineFrames.begin(); it != aPipelineFrames.end(); it++) {
+		it->samples.reserve(blockSize * numChannels);
+		it->scrubbedSamples.reserve(blockSize * numChannels);
+	}
+}
+
+void FLACScrubber::prepareFrames(unsigned numFrames) {
+	aPipelineFrames.resize(numFrames);
+	aFreeFrames.setCapacity(numFrames);
+	for(std::vector<FLACScrubberFrame>::iterator it = aPipelineFrames.begin(); it != aPipelineFrames.end(); it++) {
+		aFreeFrames.push(&*it);
+	}
+	reserveBuffers(aStreamInfo.max_blocksize, aStreamInfo.channels);
+}
+
+FLACScrubberFrame * FLACScrubber::copyFrame(const FLAC__Frame * frame, const FLAC__int32 * const buffer[], unsigned numChannels) {
+	unsigned blockSize = frame->header.blocksize;
+	FLACScrubberFrame * copy = aFreeFrames.pop();
+	copy->firstSample = frame->header.number.sample_number;
+	copy->blockSize = blockSize;
+	copy->numChannels = numChannels;
+	copy->samples.reserve(numChannels * blockSize);
+	for(unsigned channel = 0; channel < numChannels; channel++) {
+		copy->channels[channel] = copy->samples.data() + channel * blockSize;
+		memcpy(copy->channels[channel], buffer[channel], blockSize * sizeof(FLAC__int32));
+	}
+	return copy;
+}
+
+void FLACScrubber::scrubFrame(FLACScrubberFrame * frame) {
+	frame->scrubbedSamples.reserve(frame->numChannels * frame->blockSize);
+	for(unsigned channel = 0; channel < frame->numChannels; channel++) {
+		frame->scrubbedChannels[channel] = frame->scrubbedSamples.data() + channel * frame->blockSize;
+	}
+	aEngine.scrub(frame->channels, 0, frame->blockSize, frame->firstSample, frame->scrubbedChannels);
+}
+
+// Without a known length, a frame can only be scrubbed once enough samples follow it to be sure that it is
+// not in the last samples window, or once the stream has ended and the window is known. Frames always come
+// out in order, and there are never more than aDelayFrames of them held back.
+FLACScrubberFrame * FLACScrubber::releaseDelayedFrame() {
+	if(aDelayedFrames.empty()) {
+		return nullptr;
+	}
+	FLACScrubberFrame * frame = aDelayedFrames.front();
+	const FLACScrubberFrame * last = aDelayedFrames.back();
+	if(aDelayFrames && !aDelayEnded && frame->firstSample + frame->blockSize + aEngine.getLastSamplesSize() > last->firstSample + last->blockSize) {
+		return nullptr;
+	}
+	aDelayedFrames.pop_front();
+	return frame;
+}
+
+void FLACScrubber::endDelayLine() {
+	if(aDelayFrames && !aDelayedFrames.empty()) {
+		const FLACScrubberFrame * last = aDelayedFrames.back();
+		aEngine.setTotalSamples(last->firstSample + last->blockSize);
+	}
+	aDelayEnded = true;
 }
 
-inline FLAC__int32 FLACScrubber::clampSample(FLAC__int32 sampleData) {
-	if(sampleData > aMaxSampleValue) {
-		return aMaxSampleValue;
+void FLACScrubber::flushDelayedFrames() {
+	for(FLACScrubberFrame * frame = releaseDelayedFrame(); frame != nullptr; frame = releaseDelayedFrame()) {
+		if(!hasError()) {
+			scrubFrame(frame);
+			error(aEncoder.process(frame->scrubbedChannels, frame->blockSize), "Could not encode frame.");
+			showProgress(frame->firstSample + frame->blockSize);
+		}
+		aFreeFrames.push(frame);
 	}
-	if(sampleData < -aMaxSampleValue) {
-		return -aMaxSampleValue;
+}
+
+void FLACScrubber::startPipeline() {
+	prepareFrames(FLACSCRUBBER_PIPELINE_FRAMES + aDelayFrames);
+	aPipelineRunning = true;
+	aScrubThread = std::thread(&FLACScrubber::scrubStage, this);
+	aEncodeThread = std::thread(&FLACScrubber::encodeStage, this);
+}
+
+void FLACScrubber::stopPipeline() {
+	// A null frame marks the end of the stream; each stage forwards it before exiting
+	aDecodedFrames.push(nullptr);
+	aScrubThread.join();
+	aEncodeThread.join();
+	aPipelineRunning = false;
+	// Also after an error on the decoding side, which must not hide this one
+	if(aPipelineFailed) {
+		error(aPipelineError);
+	}
+}
+
+void FLACScrubber::scrubStage() {
+	FLACScrubberFrame * frame;
+	do {
+		frame = aDecodedFrames.pop();
+		if(frame != nullptr) {
+			aDelayedFrames.push_back(frame);
+		} else {
+			endDelayLine();
+		}
+		for(FLACScrubberFrame * released = releaseDelayedFrame(); released != nullptr; released = releaseDelayedFrame()) {
+			if(!aPipelineFailed) {
+				scrubFrame(released);
+			}
+			aScrubbedFrames.push(released);
+		}
+	} while(frame != nullptr);
+	aScrubbedFrames.push(nullptr);
+}
+
+void FLACScrubber::encodeStage() {
+	for(FLACScrubberFrame * frame = aScrubbedFrames.pop(); frame != nullptr; frame = aScrubbedFrames.pop()) {
+		// After a failure, keep draining frames so that the other stages never block
+		if(!aPipelineFailed) {
+			if(aEncoder.process(frame->scrubbedChannels, frame->blockSize)) {
+				showProgress(frame->firstSample + frame->blockSize);
+			} else {
+				aPipelineError = "Could not encode frame.";
+				aPipelineFailed = true;
+			}
+		}
+		aFreeFrames.push(frame);
 	}
-	return sampleData;
 }
 
 void FLACScrubber::error(std::string errorMessage) {
-	aError = errorMessage;
-	std::cerr << "\n";
-	std::cerr << " *****************\n";
-	std::cerr << " * Error message: " << aError << "\n";
-	std::cerr << " * Decoder state: " << FLAC__StreamDecoderStateString[get_state()] << "\n";
-	std::cerr << " * Encoder state: " << FLAC__StreamEncoderStateString[aEncoder.get_state()] << "\n";
-	std::cerr << " *****************" << std::endl;
+	std::vector<std::string> details;
+	details.push_back("Decoder state: " + std::string(FLAC__StreamDecoderStateString[get_state()]));
+	// The encode stage may still be using the encoder; its own errors are only reported once it has stopped
+	if(!aPipelineRunning) {
+		details.push_back("Encoder state: " + std::string(FLAC__StreamEncoderStateString[aEncoder.get_state()]));
+	}
+	aReporter.error(errorMessage, details);
 }
 
 void FLACScrubber::error(bool condition, std::string errorMessage) {
@@ -204,69 +621,104 @@ void FLACScrubber::error(bool condition, std::string errorMessage) {
 }
 
 bool FLACScrubber::hasError() {
-	return !aError.empty();
+	return aReporter.hasError();
 }
 
 void FLACScrubber::showProgress(FLAC__int64 currentSample) {
-	int percentage = (int) (100.d * (double) currentSample / (double) aTotalSamples);
-	if(percentage != aLastPercentage) {
-		aLastPercentage = percentage;
-		int numEqualSigns = (int) ((double) FLACSCRUBBER_PROGRESS_BAR_LENGTH * (double) currentSample / (double) aTotalSamples);
-		std::cerr << "\r[";
-		for(int i = 0; i < numEqualSigns; i++) {
-			std::cerr << "=";
-		}
-		for(int i = numEqualSigns; i < FLACSCRUBBER_PROGRESS_BAR_LENGTH; i++) {
-			std::cerr << " ";
-		}
-		std::cerr << "] " << percentage << "% (" << currentSample << "/" << aTotalSamples << " samples)";
-		if(percentage == 100) {
-			std::cerr << " Done" << std::endl;
+	aReporter.showProgress(currentSample, aTotalSamples, aSampleRate);
+}
+
+unsigned FLACScrubber::prepareMetadata() {
+	if(aStreaming) {
+		// The seek points could never be filled in, since the output cannot be rewritten once the stream is done
+		if(aTags == nullptr) {
+			return 0;
 		}
-		std::cerr.flush();
+		aMetadata[0] = aTags;
+		return 1;
 	}
+	if(aSeektable == nullptr) {
+		// See metadata_callback as to why this uses the C API instead of the C++ one
+		aSeektable = FLAC__metadata_object_new(FLAC__METADATA_TYPE_SEEKTABLE);
+		FLAC__metadata_object_seektable_template_append_spaced_points_by_samples(aSeektable, aSampleRate * FLACSCRUBBER_SEEKTABLE_SECONDS, aTotalSamples);
+		FLAC__metadata_object_seektable_template_sort(aSeektable, true);
+	}
+	if(aTags == nullptr) {
+		aMetadata[0] = aSeektable;
+		return 1;
+	}
+	aMetadata[0] = aTags;
+	aMetadata[1] = aSeektable;
+	return 2;
 }
 
 void FLACScrubber::initializeEncoder() {
 	if(!aEncoderInitialized) {
 		aEncoderInitialized = true;
-		// See metadata_callback as to why this uses the C API instead of the C++ one
-		aSeektable = FLAC__metadata_object_new(FLAC__METADATA_TYPE_SEEKTABLE);
-		FLAC__metadata_object_seektable_template_append_spaced_points_by_samples(aSeektable, aSampleRate * FLACSCRUBBER_SEEKTABLE_SECONDS, aTotalSamples);
-		FLAC__metadata_object_seektable_template_sort(aSeektable, true);
-		if(aTags == nullptr) {
-			aMetadata[0] = aSeektable;
-			error(aEncoder.set_metadata(aMetadata, 1), "Cannot set metadata (without tags) on the encoder.");
-		} else {
-			aMetadata[0] = aTags;
-			aMetadata[1] = aSeektable;
-			error(aEncoder.set_metadata(aMetadata, 2), "Cannot set metadata (with tags) on the encoder.");
+		unsigned numBlocks = prepareMetadata();
+		if(numBlocks > 0) {
+			error(aEncoder.set_metadata(aMetadata, numBlocks), aTags == nullptr ? "Cannot set metadata (without tags) on the encoder." : "Cannot set metadata (with tags) on the encoder.");
 		}
-		FLAC__StreamEncoderInitStatus init_status = aEncoder.init(aScrubbedFile);
+		aEncoder.setSync(aSync == FLACSCRUBBER_SYNC_FILE);
+		FLAC__StreamEncoderInitStatus init_status = aStreaming ? aEncoder.initStream(STDOUT_FILENO) : aEncoder.init(aScrubbedFile);
 		error(init_status == FLAC__STREAM_ENCODER_INIT_STATUS_OK, "Cannot initialize encoder: " + std::string(FLAC__StreamEncoderInitStatusString[init_status]));
 	}
 }
 
 FLAC__StreamDecoderWriteStatus FLACScrubber::write_callback(const FLAC__Frame * frame, const FLAC__int32 * const buffer[]) {
+	if(aLocatingLastFrame) {
+		// Inside the write callback, the decode position is right after the frame just decoded
+		if(!get_decode_position(&aLastFrameEnd)) {
+			aLastFrameEnd = 0;
+		}
+		return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+	}
+	if(aIndexingFrames) {
+		FLAC__uint64 end;
+		if(!get_decode_position(&end) || !aFrameIndex.appendFrame(frame->header.number.sample_number, frame->header.blocksize, end)) {
+			return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+		}
+		return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+	}
 	initializeEncoder();
 	int numChannels = frame->header.channels;
 	// See http://flac.sourceforge.net/format.html#frame_header
 	if(numChannels == 0b1000 || numChannels == 0b1001 || numChannels == 0b1010) {
 		numChannels = 2;
 	}
-	// Do the actual scrubbing
 	unsigned int blockSize = frame->header.blocksize;
-	FLAC__int64 sampleNumber = frame->header.number.sample_number;
-	FLAC__int32 * newBuffer = new FLAC__int32[numChannels * blockSize];
-	for(int sample = 0; sample < blockSize; sample++) {
-		for(int channel = 0; channel < numChannels; channel++) {
-			newBuffer[channel + sample * numChannels] = clampSample(buffer[channel][sample] + getRandomSample(sampleNumber));
+	if(aDelayFrames) {
+		// The delay line is sized for frames of at least the minimum block size; only the last frame may be shorter
+		error(!aShortFrameDecoded, "Frame is smaller than the minimum block size announced in STREAMINFO.");
+		aShortFrameDecoded = blockSize < aStreamInfo.min_blocksize;
+	}
+	aDecodedSamples = frame->header.number.sample_number + blockSize;
+	if(aPipelined) {
+		if(aPipelineFailed || hasError()) {
+			return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 		}
-		sampleNumber++;
+		// Hand a copy of the frame over to the scrub and encode stages
+		aDecodedFrames.push(copyFrame(frame, buffer, numChannels));
+		return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 	}
+	if(aDelayFrames) {
+		if(hasError()) {
+			return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+		}
+		aDelayedFrames.push_back(copyFrame(frame, buffer, numChannels));
+		flushDelayedFrames();
+		return hasError() ? FLAC__STREAM_DECODER_WRITE_STATUS_ABORT : FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+	}
+	// Do the actual scrubbing
+	FLAC__int64 sampleNumber = frame->header.number.sample_number;
+	aScrubbedSamples.reserve(numChannels * blockSize);
+	FLAC__int32 * scrubbed[FLAC__MAX_CHANNELS];
+	for(int channel = 0; channel < numChannels; channel++) {
+		scrubbed[channel] = aScrubbedSamples.data() + channel * blockSize;
+	}
+	aEngine.scrub(buffer, 0, blockSize, sampleNumber, scrubbed);
 	showProgress(sampleNumber + blockSize);
-	aEncoder.process_interleaved(newBuffer, blockSize);
-	delete [] newBuffer;
+	aEncoder.process(scrubbed, blockSize);
 	if(hasError()) {
 		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 	}
@@ -276,47 +728,40 @@ FLAC__StreamDecoderWriteStatus FLACScrubber::write_callback(const FLAC__Frame *
 
 void FLACScrubber::metadata_callback(const FLAC__StreamMetadata * metadata) {
 	if(metadata->type == FLAC__METADATA_TYPE_STREAMINFO) {
+		aStreamInfo = metadata->data.stream_info;
 		aTotalSamples = metadata->data.stream_info.total_samples;
 		aSampleRate = metadata->data.stream_info.sample_rate;
-		aMaxSampleValue = pow(2, metadata->data.stream_info.bits_per_sample - 1);
+		aEngine.prepare(aTotalSamples, metadata->data.stream_info.bits_per_sample, metadata->data.stream_info.channels);
+		reserveBuffers(metadata->data.stream_info.max_blocksize, metadata->data.stream_info.channels);
+		if(aTotalSamples <= 0 && aEngine.getLastSamplesSize() > 0) {
+			// Enough frames to hold back the last samples window, plus the frame that completes it and a shorter last frame
+			unsigned minBlockSize = std::max(metadata->data.stream_info.min_blocksize, (unsigned) FLAC__MIN_BLOCK_SIZE);
+			aDelayFrames = (aEngine.getLastSamplesSize() + minBlockSize - 1) / minBlockSize + 2;
+		}
 		error(aEncoder.set_bits_per_sample(metadata->data.stream_info.bits_per_sample), "Cannot set bits per sample.");
 		error(aEncoder.set_channels(metadata->data.stream_info.channels), "Cannot set number of channels.");
 		error(aEncoder.set_sample_rate(aSampleRate), "Cannot set sample rate.");
 		error(aEncoder.set_total_samples_estimate(aTotalSamples), "Cannot set total samples estimate.");
 	} else if(metadata->type == FLAC__METADATA_TYPE_VORBIS_COMMENT) {
-		FLAC::Metadata::VorbisComment comment(metadata);
-		if(comment.is_valid()) {
-			// The C++ metadata interface is pretty broken when it comes to manually inserting blocks.
-			// http://lists.xiph.org/pipermail/flac/2006-May/000563.html
-			// http://lists.xiph.org/pipermail/flac-dev/2009-February/002638.html
-			// So we use the C interface.instead. Not pretty, but at least it works.
-			FLAC__StreamMetadata * cleanBlock = FLAC__metadata_object_new(FLAC__METADATA_TYPE_VORBIS_COMMENT);
-			for(int commentIndex = 0; commentIndex < comment.get_num_comments(); commentIndex++) {
-				FLAC::Metadata::VorbisComment::Entry entry = comment.get_comment(commentIndex);
-				FLAC__StreamMetadata_VorbisComment_Entry cleanEntry;
-				// Make a null-terminated copy of the field name and value to ensure they are null-terminated strings, as the C API expects
-				char * name = (char *) calloc(entry.get_field_name_length() + 1, sizeof(char));
-				memcpy(name, entry.get_field_name(), entry.get_field_name_length());
-				std::string lowercaseTag(name);
-				std::transform(lowercaseTag.begin(), lowercaseTag.end(), lowercaseTag.begin(), tolower);
-				bool keepTag = false;
-				for(std::vector<std::string>::iterator it = aAllowedTags->begin(); it != aAllowedTags->end(); it++) {
-					if((*it).compare(lowercaseTag) == 0) {
-						keepTag = true;
-						break;
-					}
-				}
-				if(keepTag) {
-					char * value = (char *) calloc(entry.get_field_value_length() + 1, sizeof(char));
-					memcpy(value, entry.get_field_value(), entry.get_field_value_length());
-					FLAC__metadata_object_vorbiscomment_entry_from_name_value_pair(&cleanEntry, name, value);
-					FLAC__metadata_object_vorbiscomment_append_comment(cleanBlock, cleanEntry, false);
-					free(value);
-				}
-				free(name);
+		// The C++ metadata interface is pretty broken when it comes to manually inserting blocks.
+		// http://lists.xiph.org/pipermail/flac/2006-May/000563.html
+		// http://lists.xiph.org/pipermail/flac-dev/2009-February/002638.html
+		// So we use the C interface instead. It also lets field names be matched in place, and only kept comments be copied.
+		const FLAC__StreamMetadata_VorbisComment & comment = metadata->data.vorbis_comment;
+		FLAC__StreamMetadata * cleanBlock = FLAC__metadata_object_new(FLAC__METADATA_TYPE_VORBIS_COMMENT);
+		for(FLAC__uint32 commentIndex = 0; commentIndex < comment.num_comments; commentIndex++) {
+			const FLAC__StreamMetadata_VorbisComment_Entry & entry = comment.comments[commentIndex];
+			const char * name = (const char *) entry.entry;
+			// A comment without a separator has no field name, and is not valid
+			const char * separator = (const char *) memchr(name, '=', entry.length);
+			if(separator != nullptr && aAllowedTags.contains(name, separator - name)) {
+				FLAC__metadata_object_vorbiscomment_append_comment(cleanBlock, entry, true);
 			}
-			aTags = cleanBlock;
 		}
+		if(aTags != nullptr) {
+			FLAC__metadata_object_delete(aTags);
+		}
+		aTags = cleanBlock;
 	}
 }
 
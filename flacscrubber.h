@@ -32,38 +32,84 @@
 #include "FLAC++/decoder.h"
 #include "FLAC++/encoder.h"
 #include "FLAC++/metadata.h"
+#include <deque>
 #include <vector>
+#include <thread>
+#include <atomic>
+#include "alignedbuffer.h"
+#include "boundedqueue.h"
+#include "flacfileencoder.h"
+#include "flacframeindex.h"
+#include "flacmappeddecoder.h"
+#include "scrubengine.h"
+#include "scrubreporter.h"
+#include "tagwhitelist.h"
 
-#define FLACSCRUBBER_DEFAULT_FORCENONZERO false
-#define FLACSCRUBBER_DEFAULT_FIRSTSAMPLESIZE 4096
-#define FLACSCRUBBER_DEFAULT_LASTSAMPLESIZE 2048
-#define FLACSCRUBBER_DEFAULT_FIRSTSAMPLESSCRUBRATE 1
-#define FLACSCRUBBER_DEFAULT_LASTSAMPLESSCRUBRATE 1
-#define FLACSCRUBBER_DEFAULT_OTHERSAMPLESSCRUBRATE 0.2
-#define FLACSCRUBBER_DEFAULT_FIRSTSAMPLESMAXOFFSET 256
-#define FLACSCRUBBER_DEFAULT_LASTSAMPLESMAXOFFSET 256
-#define FLACSCRUBBER_DEFAULT_OTHERSAMPLESMAXOFFSET 2
 #define FLACSCRUBBER_DEFAULT_ALLOWEDTAGS "title,artist,album,albumartist,date,tracknumber,tracktotal,totaltracks,discnumber,disctotal,totaldiscs,bpm,subtitle,musicbrainz_trackid,musicbrainz_albumid,musicbrainz_artistid,musicbrainz_albumartistid,musicbrainz_discid,musicbrainz_releasegroupid,musicbrainz_workid"
 
+// Reads from standard input and writes to standard output instead of replacing a file
+#define FLACSCRUBBER_STREAM_FILE "-"
+// Appended to the name of a file to get the name of its scrubbed version until it replaces the original
+#define FLACSCRUBBER_SCRUBBING_SUFFIX ".scrubbing"
+
+// When the scrubbed files are flushed to disk: never, one by one as they are written, or all at once at the end (see main)
+enum FLACScrubberSync {
+	FLACSCRUBBER_SYNC_NONE,
+	FLACSCRUBBER_SYNC_FILE,
+	FLACSCRUBBER_SYNC_BATCH
+};
+
+#define FLACSCRUBBER_DEFAULT_SYNC FLACSCRUBBER_SYNC_NONE
+#define FLACSCRUBBER_DEFAULT_SEGMENTJOBS 1
+#define FLACSCRUBBER_DEFAULT_PIPELINED true
+#define FLACSCRUBBER_DEFAULT_SPLICE false
+#define FLACSCRUBBER_DEFAULT_CHECKPOINTSECONDS 0
+
 #define FLACSCRUBBER_SEEKTABLE_SECONDS 10
-#define FLACSCRUBBER_PROGRESS_BAR_LENGTH 40
+#define FLACSCRUBBER_BLOCKSIZE 4096
+#define FLACSCRUBBER_SEGMENT_SAMPLES (64 * FLACSCRUBBER_BLOCKSIZE)
+#define FLACSCRUBBER_PIPELINE_FRAMES 16
+#define FLACSCRUBBER_SPLICE_MAX_BLOCKSIZE 4608
+
+// A decoded frame travelling through the decode, scrub and encode stages of the pipeline
+class FLACSegmentScrubber;
+class FLACStreamWriter;
+class MD5;
+class ScrubCheckpoint;
+
+struct FLACScrubberFrame {
+	FLAC__int64 firstSample;
+	unsigned blockSize;
+	unsigned numChannels;
+	FLAC__int32 * channels[FLAC__MAX_CHANNELS];
+	AlignedBuffer<FLAC__int32> samples;
+	AlignedBuffer<FLAC__int32> scrubbedSamples;
+	FLAC__int32 * scrubbedChannels[FLAC__MAX_CHANNELS];
+};
 
-class FLACScrubber : public FLAC::Decoder::File
+class FLACScrubber : public FLACMappedDecoder
 {
 	public:
 		FLACScrubber(std::string file);
 		~FLACScrubber();
-		void setForceNonZero(bool forceNonZero);
-		void scrubFirstSamples(int maxOffset);
-		void scrubLastSamples(int maxOffset);
-		void scrubOtherSamples(int maxOffset);
-		void setFirstSamplesSize(int samples);
-		void setLastSamplesSize(int samples);
-		void setFirstSamplesScrubRate(float rate);
-		void setLastSamplesScrubRate(float rate);
-		void setOtherSamplesScrubRate(float rate);
+		ScrubEngine & getEngine();
 		void setAllowedTags(std::vector<std::string> * allowedTags);
+		void setSegmentJobs(int jobs);
+		void setPipelined(bool pipelined);
+		// Copy the frames of an unscrubbed middle of the file instead of re-encoding them; they keep their original encoding
+		void setSplice(bool splice);
+		void setSync(FLACScrubberSync sync);
+		void setTagsOnly(bool tagsOnly);
+		// Save a checkpoint to resume from every so many seconds, and resume from the last one if there is any; 0 disables checkpoints
+		void setCheckpointInterval(int seconds);
 		bool hasError();
+		// Whether file carries the stamp of a previous run with the same parameters, and has not changed since.
+		// This only reads the header and attributes of the file, so it is worth doing before setting up a scrubber.
+		static bool isScrubbed(std::string file, std::string stampParameters);
+		// What the stamp records about a run with these options; see getAllowedTagsList
+		static std::string getStampParameters(ScrubEngine & engine, bool tagsOnly, bool splice, std::string allowedTagsList);
+		// The whitelist as given to setAllowedTags, or the default one for nullptr
+		static std::string getAllowedTagsList(std::vector<std::string> * allowedTags);
 		void processEverything(bool showProgress);
 		void cancel();
 		void overwrite();
@@ -72,35 +118,82 @@ class FLACScrubber : public FLAC::Decoder::File
 		virtual void metadata_callback(const FLAC__StreamMetadata * metadata);
 		virtual void error_callback(FLAC__StreamDecoderErrorStatus status);
 	private:
+		friend class FLACSegmentScrubber;
+		friend class FLACFrameCopier;
 		bool aEncoderInitialized = false;
-		bool aShowProgress = false;
-		int aLastPercentage = -1;
-		bool aForceNonZero = false;
-		int aFirstSamplesSize = FLACSCRUBBER_DEFAULT_FIRSTSAMPLESIZE;
-		int aLastSamplesSize = FLACSCRUBBER_DEFAULT_LASTSAMPLESIZE;
-		float aFirstSamplesScrubRate = FLACSCRUBBER_DEFAULT_FIRSTSAMPLESSCRUBRATE;
-		float aLastSamplesScrubRate = FLACSCRUBBER_DEFAULT_LASTSAMPLESSCRUBRATE;
-		float aOtherSamplesScrubRate = FLACSCRUBBER_DEFAULT_OTHERSAMPLESSCRUBRATE;
-		int aFirstSamplesMaxOffset = FLACSCRUBBER_DEFAULT_FIRSTSAMPLESMAXOFFSET;
-		int aLastSamplesMaxOffset = FLACSCRUBBER_DEFAULT_LASTSAMPLESMAXOFFSET;
-		int aOtherSamplesMaxOffset = FLACSCRUBBER_DEFAULT_OTHERSAMPLESMAXOFFSET;
-		std::vector<std::string> * aAllowedTags;
+		bool aStreaming = false;
+		ScrubEngine aEngine;
+		TagWhitelist aAllowedTags;
+		std::string aAllowedTagsList = FLACSCRUBBER_DEFAULT_ALLOWEDTAGS;
+		int aSegmentJobs = FLACSCRUBBER_DEFAULT_SEGMENTJOBS;
+		FLACScrubberSync aSync = FLACSCRUBBER_DEFAULT_SYNC;
+		bool aTagsOnly = false;
+		int aCheckpointInterval = FLACSCRUBBER_DEFAULT_CHECKPOINTSECONDS;
+		unsigned aOutputBlockSize = FLACSCRUBBER_BLOCKSIZE; // Block size of the frames encoded by segment scrubbers
+		FLAC__uint64 aSpliceHeadEnd = 0;
+		FLAC__uint64 aSpliceTailStart = 0;
+		FLACFrameIndex aFrameIndex;
+		// Set while the last frame is decoded only to learn where it ends, see locateLastFrameEnd
+		bool aLocatingLastFrame = false;
+		FLAC__uint64 aLastFrameEnd = 0;
+		// Set while frames are decoded only to rebuild the frame index, see indexFramesByDecoding
+		bool aIndexingFrames = false;
+		bool aPipelined = FLACSCRUBBER_DEFAULT_PIPELINED;
+		bool aSplice = FLACSCRUBBER_DEFAULT_SPLICE;
+		AlignedBuffer<FLAC__int32> aScrubbedSamples;
+		std::vector<FLACScrubberFrame> aPipelineFrames;
+		// Frames held back while the length of the stream is unknown, see releaseDelayedFrame
+		unsigned aDelayFrames = 0;
+		std::deque<FLACScrubberFrame *> aDelayedFrames;
+		bool aDelayEnded = false;
+		bool aShortFrameDecoded = false;
+		FLAC__int64 aDecodedSamples = 0;
+		BoundedQueue<FLACScrubberFrame *> aFreeFrames;
+		BoundedQueue<FLACScrubberFrame *> aDecodedFrames;
+		BoundedQueue<FLACScrubberFrame *> aScrubbedFrames;
+		std::thread aScrubThread;
+		std::thread aEncodeThread;
+		std::atomic<bool> aPipelineFailed;
+		std::string aPipelineError;
+		bool aPipelineRunning = false; // While the encode stage owns the encoder
+		FLAC__StreamMetadata_StreamInfo aStreamInfo;
 		FLAC__int64 aTotalSamples;
 		FLAC__int32 aSampleRate;
-		FLAC__int32 aMaxSampleValue;
 		FLAC__StreamMetadata * aTags = nullptr;
 		FLAC__StreamMetadata * aSeektable = nullptr;
 		FLAC__StreamMetadata ** aMetadata = new FLAC__StreamMetadata * [2];
 		std::string aOriginalFile;
 		std::string aScrubbedFile;
-		std::string aError;
-		FLAC::Encoder::File aEncoder;
+		ScrubReporter aReporter;
+		FLACFileEncoder aEncoder;
+		std::string getStampParameters();
+		unsigned prepareMetadata();
 		void initializeEncoder();
+		void processSegments();
+		unsigned resumeSegments(ScrubCheckpoint * checkpoint, FLACStreamWriter * writer, unsigned numBlocks, MD5 * originalMD5, MD5 * scrubbedMD5);
+		void saveCheckpoint(ScrubCheckpoint * checkpoint, FLACStreamWriter * writer, unsigned segments, MD5 * originalMD5, MD5 * scrubbedMD5);
+		bool buildFrameIndex();
+		bool locateLastFrameEnd();
+		bool checkSeekFrames();
+		bool indexFramesByDecoding();
+		bool canSplice();
+		void processTagsOnly();
+		void processSplice();
+		void commitSegment(FLACSegmentScrubber * segmentScrubber, FLACStreamWriter * writer, MD5 * originalMD5, MD5 * scrubbedMD5);
+		void finishStream(FLACStreamWriter * writer, MD5 * originalMD5, MD5 * scrubbedMD5);
+		void reserveBuffers(unsigned blockSize, unsigned numChannels);
+		void prepareFrames(unsigned numFrames);
+		FLACScrubberFrame * copyFrame(const FLAC__Frame * frame, const FLAC__int32 * const buffer[], unsigned numChannels);
+		void scrubFrame(FLACScrubberFrame * frame);
+		FLACScrubberFrame * releaseDelayedFrame();
+		void endDelayLine();
+		void flushDelayedFrames();
+		void startPipeline();
+		void stopPipeline();
+		void scrubStage();
+		void encodeStage();
 		void error(std::string errorMessage);
 		void error(bool condition, std::string errorMessage);
-		FLAC__int32 getRandomSample(int sampleNumber);
-		FLAC__int32 getRandomSampleInner(int maxOffset, float rate);
-		FLAC__int32 clampSample(FLAC__int32 sampleData);
 		void showProgress(FLAC__int64 currentSample);
 };
 
@@ -0,0 +1,188 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <algorithm>
+#include <string.h>
+#include "flacsegmentscrubber.h"
+#include "flacscrubber.h"
+#include "flacstreamwriter.h"
+#include "flacformat.h"
+#include "md5.h"
+
+FLACSegmentScrubber::Encoder::Encoder(FLACSegmentScrubber * segmentScrubber) : FLAC::Encoder::Stream(), aSegmentScrubber(segmentScrubber) {
+}
+
+FLAC__StreamEncoderWriteStatus FLACSegmentScrubber::Encoder::write_callback(const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame) {
+	if(samples == 0) {
+		// Metadata; the FLACStreamWriter writes its own
+		return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+	}
+	if(!aSegmentScrubber->addFrame(buffer, bytes, samples, current_frame)) {
+		return FLAC__STREAM_ENCODER_WRITE_STATUS_FATAL_ERROR;
+	}
+	return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+FLACSegmentScrubber::FLACSegmentScrubber(FLACScrubber * scrubber) : FLACMappedDecoder(), aScrubber(scrubber), aEncoder(this) {
+	FLAC__StreamDecoderInitStatus init_status = init(aScrubber->aOriginalFile);
+	error(init_status == FLAC__STREAM_DECODER_INIT_STATUS_OK, "Cannot initialize segment decoder: " + std::string(FLAC__StreamDecoderInitStatusString[init_status]));
+}
+
+bool FLACSegmentScrubber::hasError() {
+	return !aError.empty();
+}
+
+std::string FLACSegmentScrubber::getError() {
+	return aError;
+}
+
+void FLACSegmentScrubber::error(std::string errorMessage) {
+	aError = errorMessage;
+}
+
+void FLACSegmentScrubber::error(bool condition, std::string errorMessage) {
+	if(!condition && !hasError()) {
+		error(errorMessage);
+	}
+}
+
+void FLACSegmentScrubber::scrubSegment(FLAC__uint64 firstSample, FLAC__uint64 endSample) {
+	aFirstSample = firstSample;
+	aEndSample = endSample;
+	aNextSample = firstSample;
+	aOriginalSamples.clear();
+	aScrubbedSamples.clear();
+	// Size the buffers for the whole segment up front; clear() keeps that capacity for the next segments
+	aOriginalSamples.reserve((endSample - firstSample) * aScrubber->aStreamInfo.channels);
+	aScrubbedSamples.reserve((endSample - firstSample) * aScrubber->aStreamInfo.channels);
+	aFrameData.clear();
+	aFrames.clear();
+	aRuns.clear();
+	if(hasError()) {
+		return;
+	}
+	// The encoder forgets its settings every time it is finished
+	const FLAC__StreamMetadata_StreamInfo & streamInfo = aScrubber->aStreamInfo;
+	error(aEncoder.set_verify(true), "Cannot set verification on the segment encoder.");
+	error(aEncoder.set_compression_level(8), "Cannot enable compression on the segment encoder.");
+	error(aEncoder.set_blocksize(aScrubber->aOutputBlockSize), "Cannot set the block size of the segment encoder.");
+	error(aEncoder.set_bits_per_sample(streamInfo.bits_per_sample), "Cannot set bits per sample.");
+	error(aEncoder.set_channels(streamInfo.channels), "Cannot set number of channels.");
+	error(aEncoder.set_sample_rate(streamInfo.sample_rate), "Cannot set sample rate.");
+	error(aEncoder.set_total_samples_estimate(endSample - firstSample), "Cannot set total samples estimate.");
+	if(hasError()) {
+		return;
+	}
+	FLAC__StreamEncoderInitStatus init_status = aEncoder.init();
+	error(init_status == FLAC__STREAM_ENCODER_INIT_STATUS_OK, "Cannot initialize segment encoder: " + std::string(FLAC__StreamEncoderInitStatusString[init_status]));
+	if(hasError()) {
+		return;
+	}
+	// seek_absolute already delivers the frame containing firstSample to write_callback
+	error(seek_absolute(firstSample), "Cannot seek to the beginning of a segment.");
+	while(!hasError() && aNextSample < aEndSample) {
+		error(get_state() != FLAC__STREAM_DECODER_END_OF_STREAM, "Unexpected end of stream.");
+		error(process_single(), "Could not process segment.");
+	}
+	bool finished = aEncoder.finish();
+	error(finished, "Could not finish the segment encoding process.");
+}
+
+bool FLACSegmentScrubber::commit(FLACStreamWriter * writer, MD5 * originalMD5, MD5 * scrubbedMD5) {
+	for(std::vector<Frame>::iterator it = aFrames.begin(); it != aFrames.end(); it++) {
+		if(!writer->appendFrame(&aFrameData[it->offset], it->length, it->firstSample, it->blocksize)) {
+			return false;
+		}
+	}
+	if(writer->getWrittenSamples() != aEndSample) {
+		return false;
+	}
+	unsigned bytesPerSample = (aScrubber->aStreamInfo.bits_per_sample + 7) / 8;
+	unsigned numChannels = aScrubber->aStreamInfo.channels;
+	const FLAC__int32 * original[FLAC__MAX_CHANNELS];
+	const FLAC__int32 * scrubbed[FLAC__MAX_CHANNELS];
+	for(std::vector<Run>::iterator it = aRuns.begin(); it != aRuns.end(); it++) {
+		for(unsigned channel = 0; channel < numChannels; channel++) {
+			original[channel] = &aOriginalSamples[it->start + channel * it->count];
+			scrubbed[channel] = &aScrubbedSamples[it->start + channel * it->count];
+		}
+		originalMD5->updatePlanarSamples(original, numChannels, it->count, bytesPerSample);
+		scrubbedMD5->updatePlanarSamples(scrubbed, numChannels, it->count, bytesPerSample);
+	}
+	return true;
+}
+
+bool FLACSegmentScrubber::addFrame(const FLAC__byte * buffer, size_t bytes, unsigned samples, unsigned currentFrame) {
+	// The segment starts on a block boundary, so its frames just need to be shifted by the number of blocks before it
+	FLAC__uint64 frameNumber = aFirstSample / aScrubber->aOutputBlockSize + currentFrame;
+	Frame frame;
+	frame.offset = aFrameData.size();
+	frame.firstSample = frameNumber * aScrubber->aOutputBlockSize;
+	frame.blocksize = samples;
+	if(!FLACFormat::renumberFrame(buffer, bytes, false, frameNumber, aFrameData)) {
+		error("The segment encoder produced an invalid frame.");
+		return false;
+	}
+	frame.length = aFrameData.size() - frame.offset;
+	aFrames.push_back(frame);
+	return true;
+}
+
+FLAC__StreamDecoderWriteStatus FLACSegmentScrubber::write_callback(const FLAC__Frame * frame, const FLAC__int32 * const buffer[]) {
+	FLAC__uint64 frameFirstSample = frame->header.number.sample_number;
+	FLAC__uint64 firstSample = std::max(frameFirstSample, aNextSample);
+	FLAC__uint64 endSample = std::min(frameFirstSample + frame->header.blocksize, aEndSample);
+	if(firstSample >= endSample) {
+		return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+	}
+	unsigned numChannels = frame->header.channels;
+	unsigned offset = firstSample - frameFirstSample;
+	unsigned count = endSample - firstSample;
+	Run run;
+	run.start = aScrubbedSamples.size();
+	run.count = count;
+	aRuns.push_back(run);
+	aOriginalSamples.resize(run.start + count * numChannels);
+	aScrubbedSamples.resize(run.start + count * numChannels);
+	FLAC__int32 * scrubbed[FLAC__MAX_CHANNELS];
+	for(unsigned channel = 0; channel < numChannels; channel++) {
+		memcpy(&aOriginalSamples[run.start + channel * count], buffer[channel] + offset, count * sizeof(FLAC__int32));
+		scrubbed[channel] = &aScrubbedSamples[run.start + channel * count];
+	}
+	aScrubber->aEngine.scrub(buffer, offset, count, firstSample, scrubbed);
+	aNextSample = endSample;
+	error(aEncoder.process(scrubbed, count), "Could not encode segment.");
+	if(hasError()) {
+		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+	}
+	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+void FLACSegmentScrubber::error_callback(FLAC__StreamDecoderErrorStatus status) {
+	error(FLAC__StreamDecoderErrorStatusString[status]);
+}
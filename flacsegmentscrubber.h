@@ -0,0 +1,95 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef FLACSEGMENTSCRUBBER_H
+#define FLACSEGMENTSCRUBBER_H
+
+#include "FLAC++/decoder.h"
+#include "FLAC++/encoder.h"
+#include <string>
+#include <vector>
+#include "flacmappeddecoder.h"
+
+class FLACScrubber;
+class FLACStreamWriter;
+class MD5;
+
+// Decodes, scrubs and encodes one range of samples of a file with its own decoder and encoder,
+// so that several ranges of the same file can be processed at the same time.
+// The encoded frames are renumbered to their final position in the stream and kept in memory
+// until the FLACScrubber commits them in order.
+class FLACSegmentScrubber : public FLACMappedDecoder
+{
+	public:
+		FLACSegmentScrubber(FLACScrubber * scrubber);
+		bool hasError();
+		std::string getError();
+		// Both sample numbers must be multiples of the scrubber's output block size, unless endSample is the end of the stream
+		void scrubSegment(FLAC__uint64 firstSample, FLAC__uint64 endSample);
+		bool commit(FLACStreamWriter * writer, MD5 * originalMD5, MD5 * scrubbedMD5);
+	protected:
+		virtual FLAC__StreamDecoderWriteStatus write_callback(const FLAC__Frame * frame, const FLAC__int32 * const buffer[]);
+		virtual void error_callback(FLAC__StreamDecoderErrorStatus status);
+	private:
+		class Encoder : public FLAC::Encoder::Stream
+		{
+			public:
+				Encoder(FLACSegmentScrubber * segmentScrubber);
+			protected:
+				virtual FLAC__StreamEncoderWriteStatus write_callback(const FLAC__byte buffer[], size_t bytes, unsigned samples, unsigned current_frame);
+			private:
+				FLACSegmentScrubber * aSegmentScrubber;
+		};
+		struct Frame {
+			size_t offset;
+			size_t length;
+			FLAC__uint64 firstSample;
+			unsigned blocksize;
+		};
+		// Samples decoded from one frame, stored one channel after the other from start on
+		struct Run {
+			size_t start;
+			unsigned count;
+		};
+		FLACScrubber * aScrubber;
+		Encoder aEncoder;
+		FLAC__uint64 aFirstSample = 0;
+		FLAC__uint64 aEndSample = 0;
+		FLAC__uint64 aNextSample = 0;
+		std::vector<FLAC__int32> aOriginalSamples;
+		std::vector<FLAC__int32> aScrubbedSamples;
+		std::vector<FLAC__byte> aFrameData;
+		std::vector<Frame> aFrames;
+		std::vector<Run> aRuns;
+		std::string aError;
+		void error(std::string errorMessage);
+		void error(bool condition, std::string errorMessage);
+		bool addFrame(const FLAC__byte * buffer, size_t bytes, unsigned samples, unsigned currentFrame);
+};
+
+#endif // FLACSEGMENTSCRUBBER_H
@@ -0,0 +1,212 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <algorithm>
+#include "flacstreamwriter.h"
+#include "flacformat.h"
+#include "FLAC/metadata.h"
+
+FLACStreamWriter::FLACStreamWriter() {
+}
+
+FLACStreamWriter::~FLACStreamWriter() {
+	if(aSeektable != nullptr) {
+		FLAC__metadata_object_delete(aSeektable);
+	}
+}
+
+bool FLACStreamWriter::open(std::string file, const FLAC__StreamMetadata_StreamInfo & streamInfo, FLAC__StreamMetadata ** metadata, unsigned numBlocks) {
+	std::vector<FLAC__byte> header;
+	if(!prepare(streamInfo, metadata, numBlocks, header)) {
+		return false;
+	}
+	if(!aWriter.open(file)) {
+		return false;
+	}
+	return write(header, 0);
+}
+
+bool FLACStreamWriter::resume(std::string file, const FLAC__StreamMetadata_StreamInfo & streamInfo, FLAC__StreamMetadata ** metadata, unsigned numBlocks, const State & state, const std::vector<FLAC__StreamMetadata_SeekPoint> & seekPoints) {
+	std::vector<FLAC__byte> header;
+	if(!prepare(streamInfo, metadata, numBlocks, header)) {
+		return false;
+	}
+	unsigned numPoints = aSeektable != nullptr ? aSeektable->data.seek_table.num_points : 0;
+	if(state.size < (off_t) (header.size() + state.framesBytes) || state.nextSeekPoint > numPoints || seekPoints.size() != state.nextSeekPoint) {
+		return false;
+	}
+	if(!aWriter.reopen(file, state.size)) {
+		return false;
+	}
+	aStreamInfo.min_blocksize = state.minBlocksize;
+	aStreamInfo.max_blocksize = state.maxBlocksize;
+	aStreamInfo.min_framesize = state.minFramesize;
+	aStreamInfo.max_framesize = state.maxFramesize;
+	aFramesBytes = state.framesBytes;
+	aWrittenSamples = state.writtenSamples;
+	aNumFrames = state.numFrames;
+	aLastBlocksize = state.lastBlocksize;
+	aNextSeekPoint = state.nextSeekPoint;
+	if(aSeektable != nullptr) {
+		std::copy(seekPoints.begin(), seekPoints.end(), aSeektable->data.seek_table.points);
+	}
+	return true;
+}
+
+bool FLACStreamWriter::prepare(const FLAC__StreamMetadata_StreamInfo & streamInfo, FLAC__StreamMetadata ** metadata, unsigned numBlocks, std::vector<FLAC__byte> & header) {
+	if(aSeektable != nullptr) {
+		FLAC__metadata_object_delete(aSeektable);
+		aSeektable = nullptr;
+	}
+	aStreamInfo = streamInfo;
+	aStreamInfo.min_blocksize = 0;
+	aStreamInfo.max_blocksize = 0;
+	aStreamInfo.min_framesize = 0;
+	aStreamInfo.max_framesize = 0;
+	header.push_back('f');
+	header.push_back('L');
+	header.push_back('a');
+	header.push_back('C');
+	FLACFormat::appendStreamInfo(header, aStreamInfo, numBlocks == 0);
+	for(unsigned i = 0; i < numBlocks; i++) {
+		if(metadata[i]->type == FLAC__METADATA_TYPE_SEEKTABLE) {
+			aSeektable = FLAC__metadata_object_clone(metadata[i]);
+			aSeektableOffset = header.size();
+		}
+		if(!FLACFormat::appendMetadataBlock(header, metadata[i], i == numBlocks - 1)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void FLACStreamWriter::setSync(bool sync) {
+	aWriter.setSync(sync);
+}
+
+void FLACStreamWriter::setNamed(bool named) {
+	aWriter.setNamed(named);
+}
+
+bool FLACStreamWriter::sync(State * state, std::vector<FLAC__StreamMetadata_SeekPoint> * seekPoints) {
+	if(!aWriter.sync()) {
+		return false;
+	}
+	state->size = aWriter.getSize();
+	state->minBlocksize = aStreamInfo.min_blocksize;
+	state->maxBlocksize = aStreamInfo.max_blocksize;
+	state->minFramesize = aStreamInfo.min_framesize;
+	state->maxFramesize = aStreamInfo.max_framesize;
+	state->framesBytes = aFramesBytes;
+	state->writtenSamples = aWrittenSamples;
+	state->numFrames = aNumFrames;
+	state->lastBlocksize = aLastBlocksize;
+	state->nextSeekPoint = aNextSeekPoint;
+	seekPoints->clear();
+	if(aSeektable != nullptr) {
+		seekPoints->assign(aSeektable->data.seek_table.points, aSeektable->data.seek_table.points + aNextSeekPoint);
+	}
+	return true;
+}
+
+bool FLACStreamWriter::appendFrame(const FLAC__byte * frame, size_t length, FLAC__uint64 firstSample, unsigned blocksize) {
+	if(aSeektable != nullptr) {
+		FLAC__StreamMetadata_SeekPoint * points = aSeektable->data.seek_table.points;
+		while(aNextSeekPoint < aSeektable->data.seek_table.num_points && points[aNextSeekPoint].sample_number < firstSample + blocksize) {
+			if(aNextSeekPoint > 0 && points[aNextSeekPoint - 1].sample_number == firstSample) {
+				// Two targets within the same frame; libFLAC turns the duplicate into a placeholder as well
+				points[aNextSeekPoint].sample_number = FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER;
+			} else {
+				points[aNextSeekPoint].sample_number = firstSample;
+				points[aNextSeekPoint].stream_offset = aFramesBytes;
+				points[aNextSeekPoint].frame_samples = blocksize;
+			}
+			aNextSeekPoint++;
+		}
+	}
+	// STREAMINFO's minimum block size does not account for the last block
+	if(aNumFrames > 0 && (aStreamInfo.min_blocksize == 0 || aLastBlocksize < aStreamInfo.min_blocksize)) {
+		aStreamInfo.min_blocksize = aLastBlocksize;
+	}
+	aStreamInfo.max_blocksize = std::max(aStreamInfo.max_blocksize, blocksize);
+	if(aStreamInfo.min_framesize == 0 || length < aStreamInfo.min_framesize) {
+		aStreamInfo.min_framesize = length;
+	}
+	aStreamInfo.max_framesize = std::max(aStreamInfo.max_framesize, (unsigned) length);
+	aLastBlocksize = blocksize;
+	aNumFrames++;
+	aFramesBytes += length;
+	aWrittenSamples = firstSample + blocksize;
+	return aWriter.append(frame, length);
+}
+
+bool FLACStreamWriter::finish(const FLAC__byte md5sum[16]) {
+	if(aNumFrames == 1 || aStreamInfo.min_blocksize == 0) {
+		aStreamInfo.min_blocksize = aLastBlocksize;
+	}
+	aStreamInfo.total_samples = aWrittenSamples;
+	std::copy(md5sum, md5sum + 16, aStreamInfo.md5sum);
+	std::vector<FLAC__byte> streamInfo;
+	FLACFormat::appendStreamInfo(streamInfo, aStreamInfo, false);
+	// Only rewrite the block body, so that the is-last flag written by open() stays untouched
+	streamInfo.erase(streamInfo.begin(), streamInfo.begin() + 4);
+	if(!write(streamInfo, 8)) {
+		return false;
+	}
+	if(aSeektable != nullptr) {
+		FLAC__StreamMetadata_SeekPoint * points = aSeektable->data.seek_table.points;
+		FLAC__StreamMetadata_SeekPoint * end = points + aSeektable->data.seek_table.num_points;
+		for(FLAC__StreamMetadata_SeekPoint * point = points + aNextSeekPoint; point != end; point++) {
+			point->sample_number = FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER;
+		}
+		std::stable_partition(points, end, [](const FLAC__StreamMetadata_SeekPoint & point) {
+			return point.sample_number != FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER;
+		});
+		for(FLAC__StreamMetadata_SeekPoint * point = points; point != end; point++) {
+			if(point->sample_number == FLAC__STREAM_METADATA_SEEKPOINT_PLACEHOLDER) {
+				point->stream_offset = 0;
+				point->frame_samples = 0;
+			}
+		}
+		std::vector<FLAC__byte> seektable;
+		FLACFormat::appendSeekTable(seektable, aSeektable->data.seek_table, false);
+		seektable.erase(seektable.begin(), seektable.begin() + 4);
+		if(!write(seektable, aSeektableOffset + 4)) {
+			return false;
+		}
+	}
+	return aWriter.close();
+}
+
+FLAC__uint64 FLACStreamWriter::getWrittenSamples() {
+	return aWrittenSamples;
+}
+
+bool FLACStreamWriter::write(const std::vector<FLAC__byte> & data, off_t offset) {
+	return aWriter.write(&data[0], data.size(), offset);
+}
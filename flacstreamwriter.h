@@ -0,0 +1,86 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef FLACSTREAMWRITER_H
+#define FLACSTREAMWRITER_H
+
+#include "FLAC/format.h"
+#include <sys/types.h>
+#include <string>
+#include <vector>
+#include "asyncfilewriter.h"
+
+// Assembles a FLAC file out of already-encoded frames, for when the frames do not all come
+// from a single libFLAC encoder. Seek points and STREAMINFO are filled in as frames arrive,
+// and rewritten in place once the stream is finished.
+class FLACStreamWriter
+{
+	public:
+		// Progress so far, enough to resume() the same file after a restart
+		struct State {
+			off_t size;
+			unsigned minBlocksize;
+			unsigned maxBlocksize;
+			unsigned minFramesize;
+			unsigned maxFramesize;
+			FLAC__uint64 framesBytes;
+			FLAC__uint64 writtenSamples;
+			unsigned numFrames;
+			unsigned lastBlocksize;
+			unsigned nextSeekPoint;
+		};
+		FLACStreamWriter();
+		~FLACStreamWriter();
+		// streamInfo provides the audio format and total samples; metadata may contain a VORBIS_COMMENT and a SEEKTABLE template
+		bool open(std::string file, const FLAC__StreamMetadata_StreamInfo & streamInfo, FLAC__StreamMetadata ** metadata, unsigned numBlocks);
+		// Continues a file written up to state by an earlier run, which was opened with the same arguments; seekPoints are the ones already filled in
+		bool resume(std::string file, const FLAC__StreamMetadata_StreamInfo & streamInfo, FLAC__StreamMetadata ** metadata, unsigned numBlocks, const State & state, const std::vector<FLAC__StreamMetadata_SeekPoint> & seekPoints);
+		// Flush the file to disk in finish()
+		void setSync(bool sync);
+		// Create the file under its name in open() rather than when finished, so that it can be resumed
+		void setNamed(bool named);
+		// Flushes every frame appended so far to disk, then returns the state to resume from
+		bool sync(State * state, std::vector<FLAC__StreamMetadata_SeekPoint> * seekPoints);
+		bool appendFrame(const FLAC__byte * frame, size_t length, FLAC__uint64 firstSample, unsigned blocksize);
+		bool finish(const FLAC__byte md5sum[16]);
+		FLAC__uint64 getWrittenSamples();
+	private:
+		AsyncFileWriter aWriter;
+		FLAC__StreamMetadata_StreamInfo aStreamInfo;
+		FLAC__StreamMetadata * aSeektable = nullptr;
+		off_t aSeektableOffset = 0;
+		unsigned aNextSeekPoint = 0;
+		FLAC__uint64 aFramesBytes = 0;
+		FLAC__uint64 aWrittenSamples = 0;
+		unsigned aNumFrames = 0;
+		unsigned aLastBlocksize = 0;
+		bool prepare(const FLAC__StreamMetadata_StreamInfo & streamInfo, FLAC__StreamMetadata ** metadata, unsigned numBlocks, std::vector<FLAC__byte> & header);
+		bool write(const std::vector<FLAC__byte> & data, off_t offset);
+};
+
+#endif // FLACSTREAMWRITER_H
@@ -0,0 +1,149 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "iouring.h"
+
+IOUring::IOUring() {
+}
+
+IOUring::~IOUring() {
+	close();
+}
+
+bool IOUring::setup(unsigned entries) {
+	close();
+	struct io_uring_params parameters;
+	memset(&parameters, 0, sizeof(parameters));
+	aDescriptor = (int) syscall(__NR_io_uring_setup, entries, &parameters);
+	if(aDescriptor < 0) {
+		aDescriptor = -1;
+		return false;
+	}
+	aSubmissionRingSize = parameters.sq_off.array + parameters.sq_entries * sizeof(unsigned);
+	aCompletionRingSize = parameters.cq_off.cqes + parameters.cq_entries * sizeof(struct io_uring_cqe);
+	bool singleMapping = (parameters.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if(singleMapping) {
+		aSubmissionRingSize = aCompletionRingSize = aSubmissionRingSize > aCompletionRingSize ? aSubmissionRingSize : aCompletionRingSize;
+	}
+	aSubmissionRing = mmap(nullptr, aSubmissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, aDescriptor, IORING_OFF_SQ_RING);
+	if(aSubmissionRing == MAP_FAILED) {
+		aSubmissionRing = nullptr;
+		close();
+		return false;
+	}
+	if(singleMapping) {
+		aCompletionRing = aSubmissionRing;
+	} else {
+		aCompletionRing = mmap(nullptr, aCompletionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, aDescriptor, IORING_OFF_CQ_RING);
+		if(aCompletionRing == MAP_FAILED) {
+			aCompletionRing = nullptr;
+			close();
+			return false;
+		}
+	}
+	aEntriesSize = parameters.sq_entries * sizeof(struct io_uring_sqe);
+	aEntries = mmap(nullptr, aEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, aDescriptor, IORING_OFF_SQES);
+	if(aEntries == MAP_FAILED) {
+		aEntries = nullptr;
+		close();
+		return false;
+	}
+	char * submissionRing = (char *) aSubmissionRing;
+	char * completionRing = (char *) aCompletionRing;
+	aSubmissionTail = (unsigned *) (submissionRing + parameters.sq_off.tail);
+	aSubmissionMask = (unsigned *) (submissionRing + parameters.sq_off.ring_mask);
+	aSubmissionArray = (unsigned *) (submissionRing + parameters.sq_off.array);
+	aCompletionHead = (unsigned *) (completionRing + parameters.cq_off.head);
+	aCompletionTail = (unsigned *) (completionRing + parameters.cq_off.tail);
+	aCompletionMask = (unsigned *) (completionRing + parameters.cq_off.ring_mask);
+	aCompletions = completionRing + parameters.cq_off.cqes;
+	return true;
+}
+
+void IOUring::close() {
+	if(aEntries != nullptr) {
+		munmap(aEntries, aEntriesSize);
+		aEntries = nullptr;
+	}
+	if(aCompletionRing != nullptr && aCompletionRing != aSubmissionRing) {
+		munmap(aCompletionRing, aCompletionRingSize);
+	}
+	aCompletionRing = nullptr;
+	if(aSubmissionRing != nullptr) {
+		munmap(aSubmissionRing, aSubmissionRingSize);
+		aSubmissionRing = nullptr;
+	}
+	if(aDescriptor != -1) {
+		::close(aDescriptor);
+		aDescriptor = -1;
+	}
+}
+
+bool IOUring::submitWrite(int descriptor, const void * data, size_t length, off_t offset, uint64_t userData) {
+	// Only this thread moves the tail, and the kernel consumes every entry during io_uring_enter, so the slot is free
+	unsigned tail = *aSubmissionTail;
+	unsigned index = tail & *aSubmissionMask;
+	struct io_uring_sqe * entry = (struct io_uring_sqe *) aEntries + index;
+	memset(entry, 0, sizeof(*entry));
+	entry->opcode = IORING_OP_WRITE;
+	entry->fd = descriptor;
+	entry->addr = (uint64_t) (uintptr_t) data;
+	entry->len = (uint32_t) length;
+	entry->off = (uint64_t) offset;
+	entry->user_data = userData;
+	aSubmissionArray[index] = index;
+	__atomic_store_n(aSubmissionTail, tail + 1, __ATOMIC_RELEASE);
+	while(syscall(__NR_io_uring_enter, aDescriptor, 1, 0, 0, nullptr, 0) < 0) {
+		if(errno != EINTR && errno != EAGAIN) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool IOUring::waitCompletion(uint64_t * userData, int * result) {
+	while(true) {
+		unsigned head = *aCompletionHead;
+		if(head != __atomic_load_n(aCompletionTail, __ATOMIC_ACQUIRE)) {
+			struct io_uring_cqe * completion = (struct io_uring_cqe *) aCompletions + (head & *aCompletionMask);
+			*userData = completion->user_data;
+			*result = completion->res;
+			__atomic_store_n(aCompletionHead, head + 1, __ATOMIC_RELEASE);
+			return true;
+		}
+		if(syscall(__NR_io_uring_enter, aDescriptor, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR) {
+			return false;
+		}
+	}
+}
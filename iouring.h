@@ -0,0 +1,70 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef IOURING_H
+#define IOURING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// Minimal io_uring submission and completion queue, driven through the raw system calls
+// so that liburing is not needed. Only supports the positioned writes AsyncFileWriter uses,
+// from a single thread.
+class IOUring
+{
+	public:
+		IOUring();
+		~IOUring();
+		// Fails when the kernel does not support io_uring or does not allow it
+		bool setup(unsigned entries);
+		void close();
+		// At most as many writes as the queue has entries may be pending at a time
+		bool submitWrite(int descriptor, const void * data, size_t length, off_t offset, uint64_t userData);
+		// Waits for the next completed write; result is the number of bytes written, or minus errno
+		bool waitCompletion(uint64_t * userData, int * result);
+	private:
+		int aDescriptor = -1;
+		void * aSubmissionRing = nullptr;
+		size_t aSubmissionRingSize = 0;
+		void * aCompletionRing = nullptr;
+		size_t aCompletionRingSize = 0;
+		void * aEntries = nullptr;
+		size_t aEntriesSize = 0;
+		unsigned * aSubmissionTail = nullptr;
+		unsigned * aSubmissionMask = nullptr;
+		unsigned * aSubmissionArray = nullptr;
+		unsigned * aCompletionHead = nullptr;
+		unsigned * aCompletionTail = nullptr;
+		unsigned * aCompletionMask = nullptr;
+		void * aCompletions = nullptr;
+		IOUring(const IOUring &) = delete;
+		IOUring & operator=(const IOUring &) = delete;
+};
+
+#endif // IOURING_H
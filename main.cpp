@@ -27,9 +27,22 @@
 
 #include <iostream>
 #include <stdio.h>
+#include <cstdlib>
 #include <sstream>
 #include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "batchjournal.h"
 #include "flacscrubber.h"
+#include "scrubstamp.h"
+#include "scrubcheckpoint.h"
+#include "pcmfilescrubber.h"
 #include "optionparser.h"
 
 #define _STR_EXPAND(token) #token
@@ -60,6 +73,38 @@ struct Arguments : public option::Arg {
 		}
 		return option::ARG_OK;
 	}
+	static option::ArgStatus PositiveInteger(const option::Option & option, bool msg) {
+		option::ArgStatus status = Integer(option, msg);
+		if(status != option::ARG_OK) {
+			return status;
+		}
+		if(atoi(option.arg) < 1) {
+			return argumentError(msg, "Option ", option, " must be at least 1.");
+		}
+		return option::ARG_OK;
+	}
+	static option::ArgStatus UnsignedInteger(const option::Option & option, bool msg) {
+		if(!option.arg) {
+			return argumentError(msg, "Option ", option, " cannot be empty.");
+		}
+		std::istringstream stream(option.arg);
+		unsigned long long u;
+		stream >> std::noskipws >> u;
+		if(!stream.eof() || stream.fail() || option.arg[0] == '-') {
+			return argumentError(msg, "Option ", option, " must be a non-negative integer.");
+		}
+		return option::ARG_OK;
+	}
+	static option::ArgStatus Sync(const option::Option & option, bool msg) {
+		if(!option.arg) {
+			return argumentError(msg, "Option ", option, " cannot be empty.");
+		}
+		std::string policy(option.arg);
+		if(policy != "none" && policy != "file" && policy != "batch") {
+			return argumentError(msg, "Option ", option, " must be none, file or batch.");
+		}
+		return option::ARG_OK;
+	}
 	static option::ArgStatus Rate(const option::Option & option, bool msg) {
 		if(!option.arg) {
 			return argumentError(msg, "Option ", option, " cannot be empty.");
@@ -77,58 +122,221 @@ struct Arguments : public option::Arg {
 	}
 };
 
+enum optionIndex {
+	UNKNOWN,
+	HELP,
+	FIRST_SIZE,
+	LAST_SIZE,
+	FIRST_MAX_OFFSET,
+	LAST_MAX_OFFSET,
+	OTHER_MAX_OFFSET,
+	MAX_OFFSET,
+	FIRST_RATE,
+	LAST_RATE,
+	OTHER_RATE,
+	RATE,
+	FORCE_NONZERO,
+	TAGS,
+	JOBS,
+	SEGMENT_JOBS,
+	SEED,
+	FSYNC,
+	TAGS_ONLY,
+	SKIP_SCRUBBED,
+	JOURNAL,
+	RESUME,
+	CHECKPOINT,
+	SPLICE
+};
+
+// Serializes the per-file status lines printed by concurrent jobs
+static std::mutex statusMutex;
+
+// Options of the scrubbing itself, as opposed to the file
+static void setEngineOptions(ScrubEngine & engine, option::Option * options) {
+	if(options[FIRST_SIZE]) {
+		engine.setFirstSamplesSize(atoi(options[FIRST_SIZE].arg));
+	}
+	if(options[LAST_SIZE]) {
+		engine.setLastSamplesSize(atoi(options[LAST_SIZE].arg));
+	}
+	if(options[MAX_OFFSET]) {
+		engine.scrubFirstSamples(atoi(options[MAX_OFFSET].arg));
+		engine.scrubLastSamples(atoi(options[MAX_OFFSET].arg));
+		engine.scrubOtherSamples(atoi(options[MAX_OFFSET].arg));
+	}
+	if(options[FIRST_MAX_OFFSET]) {
+		engine.scrubFirstSamples(atoi(options[FIRST_MAX_OFFSET].arg));
+	}
+	if(options[LAST_MAX_OFFSET]) {
+		engine.scrubLastSamples(atoi(options[LAST_MAX_OFFSET].arg));
+	}
+	if(options[OTHER_MAX_OFFSET]) {
+		engine.scrubOtherSamples(atoi(options[OTHER_MAX_OFFSET].arg));
+	}
+	if(options[RATE]) {
+		engine.setFirstSamplesScrubRate(atof(options[RATE].arg));
+		engine.setLastSamplesScrubRate(atof(options[RATE].arg));
+		engine.setOtherSamplesScrubRate(atof(options[RATE].arg));
+	}
+	if(options[FIRST_RATE]) {
+		engine.setFirstSamplesScrubRate(atof(options[FIRST_RATE].arg));
+	}
+	if(options[LAST_RATE]) {
+		engine.setLastSamplesScrubRate(atof(options[LAST_RATE].arg));
+	}
+	if(options[OTHER_RATE]) {
+		engine.setOtherSamplesScrubRate(atof(options[OTHER_RATE].arg));
+	}
+	if(options[FORCE_NONZERO]) {
+		engine.setForceNonZero(true);
+	}
+	if(options[SEED]) {
+		engine.setSeed(strtoull(options[SEED].arg, nullptr, 10));
+	}
+}
+
+// Options that mean the same whatever the format of the file
+template<class Scrubber> static void setScrubOptions(Scrubber & scrubber, option::Option * options, std::vector<std::string> * allowedTags) {
+	setEngineOptions(scrubber.getEngine(), options);
+	if(options[TAGS]) {
+		scrubber.setAllowedTags(allowedTags);
+	}
+	if(options[TAGS_ONLY]) {
+		scrubber.setTagsOnly(true);
+	}
+	if(options[FSYNC]) {
+		std::string policy(options[FSYNC].arg);
+		scrubber.setSync(policy == "file" ? FLACSCRUBBER_SYNC_FILE : policy == "batch" ? FLACSCRUBBER_SYNC_BATCH : FLACSCRUBBER_SYNC_NONE);
+	}
+}
+
+template<class Scrubber> static bool runScrubber(Scrubber & scrubber, const char * file, bool showProgress) {
+	scrubber.processEverything(showProgress);
+	if(scrubber.hasError()) {
+		scrubber.cancel();
+		return false;
+	}
+	scrubber.overwrite();
+	if(scrubber.hasError()) {
+		return false;
+	}
+	if(!showProgress) {
+		std::lock_guard<std::mutex> lock(statusMutex);
+		std::cerr << "Done: " << file << std::endl;
+	}
+	return true;
+}
+
+static bool scrubFile(const char * file, option::Option * options, std::vector<std::string> * allowedTags, bool showProgress, bool pipelined) {
+	{
+		std::lock_guard<std::mutex> lock(statusMutex);
+		std::cerr << "Processing file: " << file << std::endl;
+	}
+	// The stamp only takes the header and attributes of the file, so check it before setting up any scrubber
+	if(options[SKIP_SCRUBBED]) {
+		ScrubEngine engine;
+		setEngineOptions(engine, options);
+		std::string allowedTagsList = FLACScrubber::getAllowedTagsList(options[TAGS] ? allowedTags : nullptr);
+		if(FLACScrubber::isScrubbed(file, FLACScrubber::getStampParameters(engine, options[TAGS_ONLY], options[SPLICE], allowedTagsList))) {
+			std::lock_guard<std::mutex> lock(statusMutex);
+			std::cerr << "Already scrubbed: " << file << std::endl;
+			return true;
+		}
+	}
+	// Standard input is always FLAC; looking for a PCM header would open a file that happens to be named like it instead
+	std::unique_ptr<PCMFileScrubber> pcmScrubber(std::string(file) == FLACSCRUBBER_STREAM_FILE ? nullptr : PCMFileScrubber::create(file));
+	if(pcmScrubber) {
+		// Already PCM, so none of the options about decoding and encoding apply
+		if(pcmScrubber->hasError()) {
+			pcmScrubber->cancel();
+			return false;
+		}
+		setScrubOptions(*pcmScrubber, options, allowedTags);
+		return runScrubber(*pcmScrubber, file, showProgress);
+	}
+	FLACScrubber scrubber(file);
+	if(scrubber.hasError()) {
+		scrubber.cancel();
+		return false;
+	}
+	setScrubOptions(scrubber, options, allowedTags);
+	if(options[SEGMENT_JOBS]) {
+		scrubber.setSegmentJobs(atoi(options[SEGMENT_JOBS].arg));
+	}
+	scrubber.setPipelined(pipelined);
+	if(options[SPLICE]) {
+		scrubber.setSplice(true);
+	}
+	if(options[CHECKPOINT]) {
+		scrubber.setCheckpointInterval(atoi(options[CHECKPOINT].arg));
+	}
+	return runScrubber(scrubber, file, showProgress);
+}
+
+// Flushes every file system holding one of the files to disk, with one syncfs() each
+static bool syncFileSystems(const std::vector<std::string> & files) {
+	std::set<dev_t> devices;
+	bool success = true;
+	for(std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); it++) {
+		struct stat status;
+		if(stat(it->c_str(), &status) != 0) {
+			success = false;
+			continue;
+		}
+		if(!devices.insert(status.st_dev).second) {
+			continue;
+		}
+		int descriptor = open(it->c_str(), O_RDONLY);
+		if(descriptor == -1 || syncfs(descriptor) != 0) {
+			success = false;
+		}
+		if(descriptor != -1) {
+			close(descriptor);
+		}
+	}
+	return success;
+}
+
 int main(int argc, char ** argv) {
-	enum optionIndex {
-		UNKNOWN,
-		HELP,
-		FIRST_SIZE,
-		LAST_SIZE,
-		FIRST_MAX_OFFSET,
-		LAST_MAX_OFFSET,
-		OTHER_MAX_OFFSET,
-		MAX_OFFSET,
-		FIRST_RATE,
-		LAST_RATE,
-		OTHER_RATE,
-		RATE,
-		FORCE_NONZERO,
-		TAGS
-	};
 	option::Descriptor usage[] = {
 		{UNKNOWN,          0, "", "",                 option::Arg::None,  std::string("Usage: " + std::string(argc > 0 ? argv[0] : "ascrubber") + " [options] file1.flac file2.flac ...\n\n"
-		                                                                              "This program replaces the files you give it. Make backups as necessary prior to using this program.\n\n"
+		                                                                              "This program replaces the files you give it. Make backups as necessary prior to using this program.\n"
+		                                                                              "Use " FLACSCRUBBER_STREAM_FILE " as the only file to scrub standard input to standard output instead.\n"
+		                                                                              "PCM WAV, RF64 and AIFF files are scrubbed as they are, without re-encoding; options about segments,\n"
+		                                                                              "checkpoints and scrubbed file stamps only apply to FLAC files.\n\n"
 		                                                                              "Options:").c_str()},
 		{HELP,             0, "", "help",             option::Arg::None,  "  --help               \tPrint usage and exit.\n"},
 		{FIRST_SIZE,       0, "", "first-size",       Arguments::Integer, "  --first-size N       \tSize of the samples window considered to be the beginning of the file.\n"
-		                                                                  "                       \tDefault value: " _STR(FLACSCRUBBER_DEFAULT_FIRSTSAMPLESIZE) " samples.\n"},
+		                                                                  "                       \tDefault value: " _STR(SCRUBENGINE_DEFAULT_FIRSTSAMPLESIZE) " samples.\n"},
 		{LAST_SIZE,        0, "", "last-size",        Arguments::Integer, "  --last-size N        \tSize of the samples window considered to be the end of the file.\n"
-		                                                                  "                       \tDefault value: " _STR(FLACSCRUBBER_DEFAULT_LASTSAMPLESIZE) " samples.\n"},
+		                                                                  "                       \tDefault value: " _STR(SCRUBENGINE_DEFAULT_LASTSAMPLESIZE) " samples.\n"},
 		{FIRST_MAX_OFFSET, 0, "", "first-max-offset", Arguments::Integer, "  --first-max-offset N \tMaximum offset that can be applied to samples in the beginning sample window, in any direction.\n"
 		                                                                  "                       \tIf set to 0, no samples in the beginning window will be scrubbed.\n"
 		                                                                  "                       \tSamples range over all 32-bit integers.\n"
-		                                                                  "                       \tDefault value: " _STR(FLACSCRUBBER_DEFAULT_FIRSTSAMPLESMAXOFFSET) ".\n"},
+		                                                                  "                       \tDefault value: " _STR(SCRUBENGINE_DEFAULT_FIRSTSAMPLESMAXOFFSET) ".\n"},
 		{LAST_MAX_OFFSET,  0, "", "last-max-offset",  Arguments::Integer, "  --last-max-offset N  \tMaximum offset that can be applied to samples in the end sample window, in any direction.\n"
 		                                                                  "                       \tIf set to 0, no samples in the end window will be scrubbed.\n"
 		                                                                  "                       \tSamples range over all 32-bit integers.\n"
-		                                                                  "                       \tDefault value: " _STR(FLACSCRUBBER_DEFAULT_LASTSAMPLESMAXOFFSET) ".\n"},
+		                                                                  "                       \tDefault value: " _STR(SCRUBENGINE_DEFAULT_LASTSAMPLESMAXOFFSET) ".\n"},
 		{OTHER_MAX_OFFSET, 0, "", "other-max-offset", Arguments::Integer, "  --other-max-offset N \tMaximum offset that can be applied to samples in the middle of the file, in any direction.\n"
 		                                                                  "                       \tIf set to 0, no samples in the middle of the file will be scrubbed.\n"
 		                                                                  "                       \tSamples range over all 32-bit integers.\n"
-		                                                                  "                       \tDefault value: " _STR(FLACSCRUBBER_DEFAULT_OTHERSAMPLESMAXOFFSET) ".\n"},
+		                                                                  "                       \tDefault value: " _STR(SCRUBENGINE_DEFAULT_OTHERSAMPLESMAXOFFSET) ".\n"},
 		{MAX_OFFSET,       0, "", "all-max-offset",   Arguments::Integer, "  --all-max-offset N   \tShortcut to specify the maximum allowed offset to all 3 possible locations of a sample.\n"
 		                                                                  "                       \tIf set to 0, nothing will be scrubbed, which is probably not what you want.\n"},
 		{FIRST_RATE,       0, "", "first-rate",       Arguments::Rate,    "  --first-rate R       \tProbability of scrubbing a sample in the beginning sample window.\n"
 		                                                                  "                       \tFor example, a rate of 0.25 would scrub about a fourth of all the samples in the beginning window.\n"
-		                                                                  "                       \tDefault value: " _STR(FLACSCRUBBER_DEFAULT_FIRSTSAMPLESSCRUBRATE) ".\n"},
+		                                                                  "                       \tDefault value: " _STR(SCRUBENGINE_DEFAULT_FIRSTSAMPLESSCRUBRATE) ".\n"},
 		{LAST_RATE,        0, "", "last-rate",        Arguments::Rate,    "  --last-rate R        \tProbability of scrubbing a sample in the end sample window.\n"
 		                                                                  "                       \tFor example, a rate of 0.75 would scrub about three fourths of all the samples in the end window.\n"
-		                                                                  "                       \tDefault value: " _STR(FLACSCRUBBER_DEFAULT_LASTSAMPLESSCRUBRATE) ".\n"},
+		                                                                  "                       \tDefault value: " _STR(SCRUBENGINE_DEFAULT_LASTSAMPLESSCRUBRATE) ".\n"},
 		{OTHER_RATE,       0, "", "other-rate",       Arguments::Rate,    "  --other-rate R       \tProbability of scrubbing a sample in the middle of the file.\n"
 		                                                                  "                       \tFor example, a rate of 0 would scrub leave all the samples in middle of the file intact.\n"
-		                                                                  "                       \tDefault value: " _STR(FLACSCRUBBER_DEFAULT_OTHERSAMPLESSCRUBRATE) ".\n"},
+		                                                                  "                       \tDefault value: " _STR(SCRUBENGINE_DEFAULT_OTHERSAMPLESSCRUBRATE) ".\n"},
 		{RATE,             0, "", "all-rate",         Arguments::Rate,    "  --all-rate R         \tShortcut to specify the probability to scrub a sample in all 3 possible locations.\n"
 		                                                                  "                       \tFor example, a rate of 1 would scrub every single sample in the file.\n"},
-		{FORCE_NONZERO,    0, "", "force-nonzero",    option::Arg::None,  (FLACSCRUBBER_DEFAULT_FORCENONZERO ?
+		{FORCE_NONZERO,    0, "", "force-nonzero",    option::Arg::None,  (SCRUBENGINE_DEFAULT_FORCENONZERO ?
 		                                                                  "  --force-nonzero      \tIf specified, the random offset applied to any scrubbed sample cannot be 0.\n"
 		                                                                  "                       \tThis ensures that the scrubbed samples are different to the original\n"
 		                                                                  "                       \tBy default, this feature is on (scrubbing cannot leave a sample untouched).\n"
@@ -143,7 +351,45 @@ int main(int argc, char ** argv) {
 		                                                                  "                       \tNote that it is especially dangerous to keep embeded album art images, as those may contain "
 		                                                                                           "steganographical fingerprints inside the picture, which are very hard to detect.\n"
 		                                                                  "                       \tTo remove all tags, set to the empty string.\n"
-		                                                                  "                       \tDefault value: " FLACSCRUBBER_DEFAULT_ALLOWEDTAGS},
+		                                                                  "                       \tDefault value: " FLACSCRUBBER_DEFAULT_ALLOWEDTAGS "\n"},
+		{JOBS,             0, "", "jobs",             Arguments::PositiveInteger, "  --jobs N             \tNumber of files to scrub at the same time.\n"
+		                                                                  "                       \tEach file is processed independently; a file that fails to scrub does not affect the others.\n"
+		                                                                  "                       \tThe progress bar is only shown when a single job is used.\n"
+		                                                                  "                       \tDefault value: the number of processor cores.\n"},
+		{SEGMENT_JOBS,     0, "", "segment-jobs",     Arguments::PositiveInteger, "  --segment-jobs N     \tNumber of threads used to scrub and encode different parts of the same file at the same time.\n"
+		                                                                  "                       \tUseful for very long files. Combined with --jobs, up to (jobs * segment-jobs) threads are used.\n"
+		                                                                  "                       \tDefault value: " _STR(FLACSCRUBBER_DEFAULT_SEGMENTJOBS) ".\n"},
+		{SEED,             0, "", "seed",             Arguments::UnsignedInteger, "  --seed N             \tSeed of the random offsets, to make a run reproducible.\n"
+		                                                                  "                       \tThe offset of every sample only depends on the seed, its position and its channel,\n"
+		                                                                  "                       \tso the result is the same with any number of --segment-jobs.\n"
+		                                                                  "                       \tDo not use it on files you actually want to scrub, as it makes the offsets predictable.\n"
+		                                                                  "                       \tDefault value: a different random seed for every file.\n"},
+		{FSYNC,            0, "", "fsync",            Arguments::Sync,    "  --fsync P            \tWhen to flush the scrubbed files to disk: none (leave it to the system), file (each file\n"
+		                                                                  "                       \tand its directory as soon as it is replaced) or batch (once for all files, at the end).\n"
+		                                                                  "                       \tDefault value: none.\n"},
+		{TAGS_ONLY,        0, "", "tags-only",        option::Arg::None,  "  --tags-only          \tOnly apply the tag whitelist and rebuild the seek table, leaving the audio untouched.\n"
+		                                                                  "                       \tAudio frames are copied as they are instead of being decoded, scrubbed and re-encoded,\n"
+		                                                                  "                       \twhich is much faster, but does not remove fingerprints from the audio itself.\n"
+		                                                                  "                       \tAll scrubbing options are ignored. Cannot be used with " FLACSCRUBBER_STREAM_FILE ".\n"},
+		{SKIP_SCRUBBED,    0, "", "skip-scrubbed",    option::Arg::None,  "  --skip-scrubbed      \tSkip files that were already scrubbed with the same options and have not changed since.\n"
+		                                                                  "                       \tScrubbed files are marked with a \"" SCRUBSTAMP_ATTRIBUTE "\" extended attribute recording the options\n"
+		                                                                  "                       \tand the MD5 signature of the audio, which are checked against the file's header, along with\n"
+		                                                                  "                       \tits size and modification time, so that editing or replacing the file has it scrubbed again.\n"
+		                                                                  "                       \tFiles on file systems without user extended attributes are always scrubbed.\n"},
+		{JOURNAL,          0, "", "journal",          Arguments::String,  "  --journal FILE       \tRecord in FILE which files were started, scrubbed or failed, so that the batch can be resumed.\n"},
+		{RESUME,           0, "", "resume",           Arguments::String,  "  --resume FILE        \tResume the batch recorded in the journal FILE: skip the files it lists as scrubbed,\n"
+		                                                                  "                       \tclean up after the ones that were interrupted, and keep recording into it.\n"
+		                                                                  "                       \tFiles are matched by name, so give them the same way as in the interrupted run.\n"},
+		{CHECKPOINT,       0, "", "checkpoint",       Arguments::PositiveInteger, "  --checkpoint N       \tEvery N seconds, flush the scrubbed file to disk and save a checkpoint next to the original\n"
+		                                                                  "                       \t(with a \"" SCRUBCHECKPOINT_SUFFIX "\" suffix), so that an interrupted run on a long file can be resumed.\n"
+		                                                                  "                       \tA later run with the same options and --checkpoint carries on from the last checkpoint,\n"
+		                                                                  "                       \tprovided the original file has not changed, and produces the same file as an uninterrupted run.\n"
+		                                                                  "                       \tLong files are then always scrubbed in segments. Has no effect with " FLACSCRUBBER_STREAM_FILE " or --tags-only.\n"},
+		{SPLICE,           0, "", "splice",           option::Arg::None,  "  --splice             \tWhen the middle of the file is left unscrubbed (--other-rate 0 or --other-max-offset 0),\n"
+		                                                                  "                       \tcopy its frames from the original instead of re-encoding them, which is much faster.\n"
+		                                                                  "                       \tThose frames keep their original encoding (predictors, Rice parameters...), which may\n"
+		                                                                  "                       \tidentify the encoder that produced the original file. Has no effect with " FLACSCRUBBER_STREAM_FILE ",\n"
+		                                                                  "                       \t--tags-only or --checkpoint.\n"},
 		{0,                0, 0,  0,                  0,                  0}
 	};
 	if(argc > 0) { // Strip argv[0]
@@ -160,68 +406,90 @@ int main(int argc, char ** argv) {
 		option::printUsage(std::cerr, usage);
 		return 0;
 	}
+	for(int i = 0; i < parse.nonOptionsCount(); i++) {
+		if(parse.nonOptionsCount() > 1 && std::string(parse.nonOption(i)) == FLACSCRUBBER_STREAM_FILE) {
+			std::cerr << "Error: " FLACSCRUBBER_STREAM_FILE " cannot be combined with other files." << std::endl;
+			return 1;
+		}
+		if(options[TAGS_ONLY] && std::string(parse.nonOption(i)) == FLACSCRUBBER_STREAM_FILE) {
+			std::cerr << "Error: --tags-only cannot be used with " FLACSCRUBBER_STREAM_FILE "." << std::endl;
+			return 1;
+		}
+	}
 	std::vector<std::string> allowedTags;
 	if(options[TAGS]) {
-		std::stringstream tempStream(options[TAGS].arg);
-		std::string item;
-		while(std::getline(tempStream, item, ',')) {
-			allowedTags.push_back(item);
-		}
+		allowedTags = TagWhitelist::split(options[TAGS].arg);
 	}
-	for (int i = 0; i < parse.nonOptionsCount(); i++) {
-		std::cerr << "Processing file: " << parse.nonOption(i) << std::endl;
-		FLACScrubber scrubber(parse.nonOption(i));
-		if(scrubber.hasError()) {
-			scrubber.cancel();
-			continue;
-		}
-		if(options[FIRST_SIZE]) {
-			scrubber.setFirstSamplesSize(atoi(options[FIRST_SIZE].arg));
-		}
-		if(options[LAST_SIZE]) {
-			scrubber.setLastSamplesSize(atoi(options[LAST_SIZE].arg));
-		}
-		if(options[MAX_OFFSET]) {
-			scrubber.scrubFirstSamples(atoi(options[MAX_OFFSET].arg));
-			scrubber.scrubLastSamples(atoi(options[MAX_OFFSET].arg));
-			scrubber.scrubOtherSamples(atoi(options[MAX_OFFSET].arg));
-		}
-		if(options[FIRST_MAX_OFFSET]) {
-			scrubber.scrubFirstSamples(atoi(options[FIRST_MAX_OFFSET].arg));
-		}
-		if(options[LAST_MAX_OFFSET]) {
-			scrubber.scrubLastSamples(atoi(options[LAST_MAX_OFFSET].arg));
-		}
-		if(options[OTHER_MAX_OFFSET]) {
-			scrubber.scrubOtherSamples(atoi(options[OTHER_MAX_OFFSET].arg));
-		}
-		if(options[RATE]) {
-			scrubber.setFirstSamplesScrubRate(atof(options[RATE].arg));
-			scrubber.setLastSamplesScrubRate(atof(options[RATE].arg));
-			scrubber.setOtherSamplesScrubRate(atof(options[RATE].arg));
-		}
-		if(options[FIRST_RATE]) {
-			scrubber.setFirstSamplesScrubRate(atof(options[FIRST_RATE].arg));
-		}
-		if(options[LAST_RATE]) {
-			scrubber.setLastSamplesScrubRate(atof(options[LAST_RATE].arg));
-		}
-		if(options[OTHER_RATE]) {
-			scrubber.setOtherSamplesScrubRate(atof(options[OTHER_RATE].arg));
-		}
-		if(options[FORCE_NONZERO]) {
-			scrubber.setForceNonZero(true);
+	int jobs = std::thread::hardware_concurrency();
+	if(options[JOBS]) {
+		jobs = atoi(options[JOBS].arg);
+	}
+	if(jobs > parse.nonOptionsCount()) {
+		jobs = parse.nonOptionsCount();
+	}
+	if(jobs < 1) {
+		jobs = 1;
+	}
+	// Decoding, scrubbing and encoding each file in separate threads only pays off if there are idle cores left
+	bool pipelined = jobs < (int) std::thread::hardware_concurrency();
+	BatchJournal journal;
+	bool resume = options[RESUME];
+	if(resume || options[JOURNAL]) {
+		std::string journalFile(resume ? options[RESUME].arg : options[JOURNAL].arg);
+		if(!journal.open(journalFile)) {
+			std::cerr << "Error: Cannot open journal " << journalFile << "." << std::endl;
+			return 1;
 		}
-		if(options[TAGS]) {
-			scrubber.setAllowedTags(&allowedTags);
+	}
+	if(resume) {
+		// Scrubbed versions left behind by files the interruption caught in the middle, unless a checkpoint can carry them on
+		std::vector<std::string> interrupted = journal.getInterrupted();
+		for(std::vector<std::string>::iterator it = interrupted.begin(); it != interrupted.end(); it++) {
+			if(options[CHECKPOINT] && access(ScrubCheckpoint::getPath(*it).c_str(), F_OK) == 0) {
+				continue;
+			}
+			std::remove((*it + FLACSCRUBBER_SCRUBBING_SUFFIX).c_str());
 		}
-		scrubber.processEverything(true);
-		if(scrubber.hasError()) {
-			scrubber.cancel();
-			continue;
+	}
+	std::atomic<int> nextFile(0);
+	std::atomic<int> failedFiles(0);
+	std::vector<std::string> scrubbedFiles;
+	auto worker = [&]() {
+		for(int i = nextFile++; i < parse.nonOptionsCount(); i = nextFile++) {
+			std::string file(parse.nonOption(i));
+			if(resume && journal.isCommitted(file)) {
+				continue;
+			}
+			journal.recordStart(file);
+			if(!scrubFile(file.c_str(), options, &allowedTags, jobs == 1, pipelined)) {
+				journal.recordFailure(file);
+				failedFiles++;
+				continue;
+			}
+			journal.recordCommit(file);
+			if(file != FLACSCRUBBER_STREAM_FILE) {
+				std::lock_guard<std::mutex> lock(statusMutex);
+				scrubbedFiles.push_back(file);
+			}
 		}
-		scrubber.overwrite();
+	};
+	std::vector<std::thread> workers;
+	for(int i = 1; i < jobs; i++) {
+		workers.push_back(std::thread(worker));
+	}
+	worker();
+	for(std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); it++) {
+		it->join();
+	}
+	if(options[FSYNC] && std::string(options[FSYNC].arg) == "batch" && !syncFileSystems(scrubbedFiles)) {
+		std::cerr << "Error: Could not flush the scrubbed files to disk." << std::endl;
+		return 1;
+	}
+	if(!journal.close()) {
+		std::cerr << "Error: Could not flush the journal to disk." << std::endl;
+		return 1;
 	}
+	return failedFiles ? 1 : 0;
 }
 
 #undef _RATE
@@ -0,0 +1,91 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mappedfile.h"
+
+MappedFile::MappedFile() {
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+bool MappedFile::open(std::string file) {
+	close();
+	aDescriptor = ::open(file.c_str(), O_RDONLY);
+	if(aDescriptor == -1) {
+		return false;
+	}
+	struct stat status;
+	if(fstat(aDescriptor, &status) != 0) {
+		close();
+		return false;
+	}
+	aSize = (size_t) status.st_size;
+	if(aSize == 0) {
+		// mmap refuses empty mappings
+		return true;
+	}
+	aData = mmap(nullptr, aSize, PROT_READ, MAP_PRIVATE, aDescriptor, 0);
+	if(aData == MAP_FAILED) {
+		aData = nullptr;
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close() {
+	if(aData != nullptr) {
+		munmap(aData, aSize);
+		aData = nullptr;
+	}
+	if(aDescriptor != -1) {
+		::close(aDescriptor);
+		aDescriptor = -1;
+	}
+	aSize = 0;
+}
+
+void MappedFile::adviseSequential() {
+	if(aData != nullptr) {
+		madvise(aData, aSize, MADV_SEQUENTIAL);
+	}
+}
+
+const uint8_t * MappedFile::data() {
+	return (const uint8_t *) aData;
+}
+
+size_t MappedFile::size() {
+	return aSize;
+}
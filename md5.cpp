@@ -0,0 +1,190 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <string.h>
+#include "md5.h"
+
+#define MD5_SAMPLE_BUFFER_SIZE 4096
+
+static const uint32_t md5Constants[64] = {
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const unsigned md5Shifts[64] = {
+	7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+	5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+	4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+	6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+MD5::MD5() {
+	aState[0] = 0x67452301;
+	aState[1] = 0xefcdab89;
+	aState[2] = 0x98badcfe;
+	aState[3] = 0x10325476;
+	aLength = 0;
+}
+
+void MD5::transform(const uint8_t block[64]) {
+	uint32_t words[16];
+	for(int i = 0; i < 16; i++) {
+		words[i] = (uint32_t) block[i * 4] | ((uint32_t) block[i * 4 + 1] << 8) | ((uint32_t) block[i * 4 + 2] << 16) | ((uint32_t) block[i * 4 + 3] << 24);
+	}
+	uint32_t a = aState[0];
+	uint32_t b = aState[1];
+	uint32_t c = aState[2];
+	uint32_t d = aState[3];
+	for(int i = 0; i < 64; i++) {
+		uint32_t f;
+		int g;
+		if(i < 16) {
+			f = (b & c) | (~b & d);
+			g = i;
+		} else if(i < 32) {
+			f = (d & b) | (~d & c);
+			g = (5 * i + 1) % 16;
+		} else if(i < 48) {
+			f = b ^ c ^ d;
+			g = (3 * i + 5) % 16;
+		} else {
+			f = c ^ (b | ~d);
+			g = (7 * i) % 16;
+		}
+		uint32_t rotated = a + f + md5Constants[i] + words[g];
+		a = d;
+		d = c;
+		c = b;
+		b = b + ((rotated << md5Shifts[i]) | (rotated >> (32 - md5Shifts[i])));
+	}
+	aState[0] += a;
+	aState[1] += b;
+	aState[2] += c;
+	aState[3] += d;
+}
+
+void MD5::update(const void * data, size_t length) {
+	const uint8_t * bytes = (const uint8_t *) data;
+	size_t buffered = aLength % 64;
+	aLength += length;
+	if(buffered) {
+		size_t missing = 64 - buffered;
+		if(length < missing) {
+			memcpy(aBuffer + buffered, bytes, length);
+			return;
+		}
+		memcpy(aBuffer + buffered, bytes, missing);
+		transform(aBuffer);
+		bytes += missing;
+		length -= missing;
+	}
+	while(length >= 64) {
+		transform(bytes);
+		bytes += 64;
+		length -= 64;
+	}
+	memcpy(aBuffer, bytes, length);
+}
+
+void MD5::updateSamples(const int32_t * samples, size_t count, unsigned bytesPerSample) {
+	uint8_t buffer[MD5_SAMPLE_BUFFER_SIZE];
+	size_t samplesPerBuffer = MD5_SAMPLE_BUFFER_SIZE / bytesPerSample;
+	while(count) {
+		size_t chunk = count < samplesPerBuffer ? count : samplesPerBuffer;
+		uint8_t * out = buffer;
+		for(size_t i = 0; i < chunk; i++) {
+			uint32_t sample = (uint32_t) samples[i];
+			for(unsigned byte = 0; byte < bytesPerSample; byte++) {
+				*out++ = (uint8_t) (sample >> (8 * byte));
+			}
+		}
+		update(buffer, chunk * bytesPerSample);
+		samples += chunk;
+		count -= chunk;
+	}
+}
+
+void MD5::updatePlanarSamples(const int32_t * const channels[], unsigned numChannels, size_t count, unsigned bytesPerSample) {
+	uint8_t buffer[MD5_SAMPLE_BUFFER_SIZE];
+	size_t samplesPerBuffer = MD5_SAMPLE_BUFFER_SIZE / (bytesPerSample * numChannels);
+	size_t done = 0;
+	while(done < count) {
+		size_t chunk = count - done < samplesPerBuffer ? count - done : samplesPerBuffer;
+		uint8_t * out = buffer;
+		for(size_t i = done; i < done + chunk; i++) {
+			for(unsigned channel = 0; channel < numChannels; channel++) {
+				uint32_t sample = (uint32_t) channels[channel][i];
+				for(unsigned byte = 0; byte < bytesPerSample; byte++) {
+					*out++ = (uint8_t) (sample >> (8 * byte));
+				}
+			}
+		}
+		update(buffer, chunk * bytesPerSample * numChannels);
+		done += chunk;
+	}
+}
+
+void MD5::finish(uint8_t digest[16]) {
+	uint64_t bitLength = aLength * 8;
+	uint8_t padding[72];
+	size_t paddingLength = 64 - (aLength % 64);
+	if(paddingLength < 9) {
+		paddingLength += 64;
+	}
+	memset(padding, 0, sizeof(padding));
+	padding[0] = 0x80;
+	for(int i = 0; i < 8; i++) {
+		padding[paddingLength - 8 + i] = (uint8_t) (bitLength >> (8 * i));
+	}
+	update(padding, paddingLength);
+	for(int i = 0; i < 4; i++) {
+		for(int byte = 0; byte < 4; byte++) {
+			digest[i * 4 + byte] = (uint8_t) (aState[i] >> (8 * byte));
+		}
+	}
+}
+
+MD5::State MD5::getState() {
+	State state;
+	memcpy(state.state, aState, sizeof(aState));
+	state.length = aLength;
+	memcpy(state.buffer, aBuffer, sizeof(aBuffer));
+	return state;
+}
+
+void MD5::setState(const State & state) {
+	memcpy(aState, state.state, sizeof(aState));
+	aLength = state.length;
+	memcpy(aBuffer, state.buffer, sizeof(aBuffer));
+}
@@ -0,0 +1,62 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef MD5_H
+#define MD5_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Plain RFC 1321 MD5, used to compute the STREAMINFO signature of streams that
+// are not written by a single libFLAC encoder (libFLAC does not export its own).
+class MD5
+{
+	public:
+		// Everything needed to carry on hashing later, as saved in checkpoints
+		struct State {
+			uint32_t state[4];
+			uint64_t length;
+			uint8_t buffer[64];
+		};
+		MD5();
+		void update(const void * data, size_t length);
+		// Hashes interleaved samples the way FLAC does: little-endian, bytesPerSample bytes each
+		void updateSamples(const int32_t * samples, size_t count, unsigned bytesPerSample);
+		// Same, for count samples of each of numChannels separate channels, interleaving them on the fly
+		void updatePlanarSamples(const int32_t * const channels[], unsigned numChannels, size_t count, unsigned bytesPerSample);
+		void finish(uint8_t digest[16]);
+		State getState();
+		void setState(const State & state);
+	private:
+		uint32_t aState[4];
+		uint64_t aLength;
+		uint8_t aBuffer[64];
+		void transform(const uint8_t block[64]);
+};
+
+#endif // MD5_H
@@ -0,0 +1,134 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "pcmcodec.h"
+
+// CHANNELS = 0 takes the number of channels from numChannels
+template<unsigned BYTES, bool BIGENDIAN, unsigned CHANNELS> static void decodeFor(const uint8_t * in, unsigned numChannels, unsigned count, unsigned shift, uint32_t flip, int32_t * const out[]) {
+	if(CHANNELS) {
+		numChannels = CHANNELS;
+	}
+	for(unsigned i = 0; i < count; i++) {
+		for(unsigned channel = 0; channel < numChannels; channel++) {
+			uint32_t container = 0;
+			for(unsigned byte = 0; byte < BYTES; byte++) {
+				container |= (uint32_t) in[BIGENDIAN ? BYTES - 1 - byte : byte] << (8 * byte);
+			}
+			// Sign-extend from the top of the container, then drop its unused bits
+			int32_t sample = (int32_t) ((container ^ flip) << (32 - 8 * BYTES)) >> (32 - 8 * BYTES);
+			out[channel][i] = sample >> shift;
+			in += BYTES;
+		}
+	}
+}
+
+template<unsigned BYTES, bool BIGENDIAN, unsigned CHANNELS> static void encodeFor(const int32_t * const in[], unsigned numChannels, unsigned count, unsigned shift, uint32_t flip, uint8_t * out) {
+	if(CHANNELS) {
+		numChannels = CHANNELS;
+	}
+	for(unsigned i = 0; i < count; i++) {
+		for(unsigned channel = 0; channel < numChannels; channel++) {
+			uint32_t container = ((uint32_t) in[channel][i] << shift) ^ flip;
+			for(unsigned byte = 0; byte < BYTES; byte++) {
+				out[BIGENDIAN ? BYTES - 1 - byte : byte] = (uint8_t) (container >> (8 * byte));
+			}
+			out += BYTES;
+		}
+	}
+}
+
+PCMCodec::PCMCodec(const PCMLayout & layout, unsigned numChannels) : aNumChannels(numChannels) {
+	aFrameSize = layout.bytesPerSample * numChannels;
+	aShift = 8 * layout.bytesPerSample - layout.bitsPerSample;
+	aFlip = layout.isUnsigned ? 1u << (8 * layout.bytesPerSample - 1) : 0;
+	if(layout.bytesPerSample == 1) {
+		select<1, false>();
+	} else if(layout.bigEndian) {
+		selectBigEndian(layout.bytesPerSample);
+	} else {
+		selectLittleEndian(layout.bytesPerSample);
+	}
+}
+
+bool PCMCodec::isSupported(const PCMLayout & layout) {
+	return layout.bytesPerSample >= 1 && layout.bytesPerSample <= 4 && layout.bitsPerSample >= 1 && layout.bitsPerSample <= 8 * layout.bytesPerSample;
+}
+
+unsigned PCMCodec::getFrameSize() {
+	return aFrameSize;
+}
+
+void PCMCodec::decode(const uint8_t * in, unsigned count, int32_t * const out[]) {
+	aDecode(in, aNumChannels, count, aShift, aFlip, out);
+}
+
+void PCMCodec::encode(const int32_t * const in[], unsigned count, uint8_t * out) {
+	aEncode(in, aNumChannels, count, aShift, aFlip, out);
+}
+
+void PCMCodec::selectBigEndian(unsigned bytesPerSample) {
+	switch(bytesPerSample) {
+		case 2:
+			select<2, true>();
+			break;
+		case 3:
+			select<3, true>();
+			break;
+		default:
+			select<4, true>();
+	}
+}
+
+void PCMCodec::selectLittleEndian(unsigned bytesPerSample) {
+	switch(bytesPerSample) {
+		case 2:
+			select<2, false>();
+			break;
+		case 3:
+			select<3, false>();
+			break;
+		default:
+			select<4, false>();
+	}
+}
+
+template<unsigned BYTES, bool BIGENDIAN> void PCMCodec::select() {
+	switch(aNumChannels) {
+		case 1:
+			aDecode = decodeFor<BYTES, BIGENDIAN, 1>;
+			aEncode = encodeFor<BYTES, BIGENDIAN, 1>;
+			break;
+		case 2:
+			aDecode = decodeFor<BYTES, BIGENDIAN, 2>;
+			aEncode = encodeFor<BYTES, BIGENDIAN, 2>;
+			break;
+		default:
+			aDecode = decodeFor<BYTES, BIGENDIAN, 0>;
+			aEncode = encodeFor<BYTES, BIGENDIAN, 0>;
+	}
+}
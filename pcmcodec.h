@@ -0,0 +1,67 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef PCMCODEC_H
+#define PCMCODEC_H
+
+#include <stdint.h>
+
+// How uncompressed samples are laid out: interleaved, in containers of bytesPerSample bytes holding
+// bitsPerSample significant bits at their top, the rest being zero
+struct PCMLayout {
+	unsigned bytesPerSample;
+	unsigned bitsPerSample;
+	bool bigEndian;
+	bool isUnsigned; // Offset binary, as in 8-bit WAV files
+};
+
+// Converts between interleaved PCM and planes of 32-bit samples, with a loop compiled for each
+// container size and byte order, and unrolled for mono and stereo
+class PCMCodec
+{
+	public:
+		PCMCodec(const PCMLayout & layout, unsigned numChannels);
+		static bool isSupported(const PCMLayout & layout);
+		unsigned getFrameSize();
+		void decode(const uint8_t * in, unsigned count, int32_t * const out[]);
+		void encode(const int32_t * const in[], unsigned count, uint8_t * out);
+	private:
+		typedef void (* Decode)(const uint8_t * in, unsigned numChannels, unsigned count, unsigned shift, uint32_t flip, int32_t * const out[]);
+		typedef void (* Encode)(const int32_t * const in[], unsigned numChannels, unsigned count, unsigned shift, uint32_t flip, uint8_t * out);
+		unsigned aNumChannels;
+		unsigned aFrameSize;
+		unsigned aShift; // Unused low bits of each container
+		uint32_t aFlip; // Sign bit of unsigned containers, which turns them into signed ones
+		Decode aDecode;
+		Encode aEncode;
+		void selectBigEndian(unsigned bytesPerSample);
+		void selectLittleEndian(unsigned bytesPerSample);
+		template<unsigned BYTES, bool BIGENDIAN> void select();
+};
+
+#endif // PCMCODEC_H
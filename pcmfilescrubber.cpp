@@ -0,0 +1,222 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <cstdio>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include "pcmfilescrubber.h"
+#include "pcmsink.h"
+#include "pcmsource.h"
+#include "aiffscrubber.h"
+#include "wavscrubber.h"
+
+PCMFileScrubber::PCMFileScrubber(std::string file) : aOriginalFile(file), aScrubbedFile(file + FLACSCRUBBER_SCRUBBING_SUFFIX), aReporter(file) {
+	error(aMappedFile.open(file), "Cannot open file.");
+	aAllowedTags.assign(TagWhitelist::split(FLACSCRUBBER_DEFAULT_ALLOWEDTAGS));
+}
+
+PCMFileScrubber::~PCMFileScrubber() {
+}
+
+PCMFileScrubber * PCMFileScrubber::create(std::string file) {
+	int descriptor = open(file.c_str(), O_RDONLY);
+	if(descriptor == -1) {
+		return nullptr;
+	}
+	uint8_t header[12];
+	ssize_t length = pread(descriptor, header, sizeof(header), 0);
+	close(descriptor);
+	if(length != sizeof(header)) {
+		return nullptr;
+	}
+	uint32_t id = readLE32(header);
+	uint32_t type = readLE32(header + 8);
+	if((id == WAVSCRUBBER_RIFF || id == WAVSCRUBBER_RF64) && type == WAVSCRUBBER_WAVE) {
+		return new WAVScrubber(file);
+	}
+	if(id == AIFFSCRUBBER_FORM && (type == AIFFSCRUBBER_AIFF || type == AIFFSCRUBBER_AIFC)) {
+		return new AIFFScrubber(file);
+	}
+	return nullptr;
+}
+
+ScrubEngine & PCMFileScrubber::getEngine() {
+	return aEngine;
+}
+
+void PCMFileScrubber::setAllowedTags(std::vector<std::string> * allowedTags) {
+	aAllowedTags.assign(*allowedTags);
+}
+
+void PCMFileScrubber::setSync(FLACScrubberSync sync) {
+	aSync = sync;
+}
+
+void PCMFileScrubber::setTagsOnly(bool tagsOnly) {
+	aTagsOnly = tagsOnly;
+}
+
+void PCMFileScrubber::processEverything(bool showProgress) {
+	aReporter.setShowProgress(showProgress);
+	if(hasError() || !parse()) {
+		return;
+	}
+	aTotalSamples = aSamplesSize / (aLayout.bytesPerSample * aNumChannels);
+	aMappedFile.adviseSequential();
+	// Work out which chunks are kept and how large they are, then write them in their original order;
+	// all but the samples are small enough to hold in memory
+	std::vector<size_t> kept;
+	uint64_t fileSize = 12;
+	for(size_t i = 0; i < aChunks.size(); i++) {
+		std::vector<uint8_t> body;
+		if(!rebuildChunk(i, 0, body)) {
+			continue;
+		}
+		uint64_t size = body.size() + (i == aSamplesChunk ? aSamplesSize : 0);
+		fileSize += 8 + size + (size & 1);
+		kept.push_back(i);
+	}
+	aWriter.setSync(aSync == FLACSCRUBBER_SYNC_FILE);
+	error(aWriter.open(aScrubbedFile), "Cannot open the scrubbed file for writing.");
+	if(hasError()) {
+		return;
+	}
+	std::vector<uint8_t> header;
+	appendFileHeader(header, fileSize);
+	for(std::vector<size_t>::iterator it = kept.begin(); it != kept.end() && !hasError(); it++) {
+		std::vector<uint8_t> body;
+		rebuildChunk(*it, fileSize, body);
+		uint64_t size = body.size() + (*it == aSamplesChunk ? aSamplesSize : 0);
+		appendChunkHeader(header, aChunks[*it].id, size);
+		header.insert(header.end(), body.begin(), body.end());
+		if(*it == aSamplesChunk) {
+			// The samples stream right behind what comes before them
+			error(aWriter.append(&header[0], header.size()) && writeSamples(), "Could not write to the scrubbed file.");
+			header.clear();
+		}
+		if(size & 1) {
+			header.push_back(0);
+		}
+	}
+	if(!header.empty() && !hasError()) {
+		error(aWriter.append(&header[0], header.size()), "Could not write to the scrubbed file.");
+	}
+	// Also on failure, so that cancel() finds the partial file where it expects it
+	bool closed = aWriter.close();
+	error(!hasError() || closed, "Could not finish writing the scrubbed file.");
+	if(hasError()) {
+		return;
+	}
+	aReporter.finishProgress(aTotalSamples);
+}
+
+void PCMFileScrubber::cancel() {
+	std::remove(aScrubbedFile.c_str());
+}
+
+void PCMFileScrubber::overwrite() {
+	error(AsyncFileWriter::replace(aScrubbedFile, aOriginalFile, aSync == FLACSCRUBBER_SYNC_FILE), "Could not replace the original file by the scrubbed version.");
+}
+
+bool PCMFileScrubber::writeSamples() {
+	const uint8_t * samples = aMappedFile.data() + aSamplesOffset;
+	uint64_t scrubbedBytes = 0;
+	if(!aTagsOnly) {
+		PCMSource source(samples, aSamplesSize, aLayout, aNumChannels);
+		PCMSink sink(&aWriter, aLayout, aNumChannels);
+		if(!aEngine.process(&source, &sink, [this](int64_t currentSample) { showProgress(currentSample); })) {
+			return false;
+		}
+		scrubbedBytes = aTotalSamples * aLayout.bytesPerSample * aNumChannels;
+	}
+	// Copied as they are: everything with --tags-only, otherwise a partial sample frame at the end, if any
+	for(uint64_t offset = scrubbedBytes; offset < aSamplesSize; offset += PCMFILESCRUBBER_COPY_BYTES) {
+		uint64_t end = std::min(offset + PCMFILESCRUBBER_COPY_BYTES, aSamplesSize);
+		if(!aWriter.append(samples + offset, end - offset)) {
+			return false;
+		}
+		showProgress(end / (aLayout.bytesPerSample * aNumChannels));
+	}
+	return true;
+}
+
+void PCMFileScrubber::error(std::string errorMessage) {
+	aReporter.error(errorMessage);
+}
+
+void PCMFileScrubber::error(bool condition, std::string errorMessage) {
+	if(!condition) {
+		error(errorMessage);
+	}
+}
+
+bool PCMFileScrubber::hasError() {
+	return aReporter.hasError();
+}
+
+void PCMFileScrubber::showProgress(int64_t currentSample) {
+	aReporter.showProgress(currentSample, aTotalSamples, 0);
+}
+
+uint16_t PCMFileScrubber::readLE16(const uint8_t * bytes) {
+	return (uint16_t) (bytes[0] | bytes[1] << 8);
+}
+
+uint32_t PCMFileScrubber::readLE32(const uint8_t * bytes) {
+	return (uint32_t) bytes[0] | (uint32_t) bytes[1] << 8 | (uint32_t) bytes[2] << 16 | (uint32_t) bytes[3] << 24;
+}
+
+uint64_t PCMFileScrubber::readLE64(const uint8_t * bytes) {
+	return (uint64_t) readLE32(bytes) | (uint64_t) readLE32(bytes + 4) << 32;
+}
+
+uint16_t PCMFileScrubber::readBE16(const uint8_t * bytes) {
+	return (uint16_t) (bytes[0] << 8 | bytes[1]);
+}
+
+uint32_t PCMFileScrubber::readBE32(const uint8_t * bytes) {
+	return (uint32_t) bytes[0] << 24 | (uint32_t) bytes[1] << 16 | (uint32_t) bytes[2] << 8 | (uint32_t) bytes[3];
+}
+
+void PCMFileScrubber::appendLE32(std::vector<uint8_t> & out, uint32_t value) {
+	for(int i = 0; i < 4; i++) {
+		out.push_back((uint8_t) (value >> (8 * i)));
+	}
+}
+
+void PCMFileScrubber::appendLE64(std::vector<uint8_t> & out, uint64_t value) {
+	appendLE32(out, (uint32_t) value);
+	appendLE32(out, (uint32_t) (value >> 32));
+}
+
+void PCMFileScrubber::appendBE32(std::vector<uint8_t> & out, uint32_t value) {
+	for(int i = 3; i >= 0; i--) {
+		out.push_back((uint8_t) (value >> (8 * i)));
+	}
+}
@@ -0,0 +1,114 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef PCMFILESCRUBBER_H
+#define PCMFILESCRUBBER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "asyncfilewriter.h"
+#include "flacscrubber.h"
+#include "mappedfile.h"
+#include "pcmcodec.h"
+#include "scrubengine.h"
+#include "scrubreporter.h"
+#include "tagwhitelist.h"
+
+// Chunk identifiers, as the four characters appear in the file
+#define PCMFILESCRUBBER_ID(a, b, c, d) ((uint32_t) (a) | ((uint32_t) (b) << 8) | ((uint32_t) (c) << 16) | ((uint32_t) (d) << 24))
+#define PCMFILESCRUBBER_COPY_BYTES (1 << 20)
+
+// Scrubs files holding uncompressed PCM in chunks, such as WAV and AIFF, without going through a codec:
+// the file is mapped, and its samples go straight from the mapping through the scrub engine into the
+// scrubbed copy. Subclasses parse their container and decide which chunks the copy keeps, so that only
+// what is needed to play the file and the whitelisted tags make it through. Options mean the same as
+// for FLACScrubber, and the scrubbed file replaces the original the same way.
+class PCMFileScrubber
+{
+	public:
+		virtual ~PCMFileScrubber();
+		// A scrubber for file if it is in a format handled here, nullptr otherwise
+		static PCMFileScrubber * create(std::string file);
+		ScrubEngine & getEngine();
+		void setAllowedTags(std::vector<std::string> * allowedTags);
+		void setSync(FLACScrubberSync sync);
+		void setTagsOnly(bool tagsOnly);
+		bool hasError();
+		void processEverything(bool showProgress);
+		void cancel();
+		void overwrite();
+	protected:
+		struct Chunk {
+			uint32_t id;
+			uint64_t offset; // Of the chunk body in the file
+			uint64_t size;
+		};
+		MappedFile aMappedFile;
+		TagWhitelist aAllowedTags;
+		std::vector<Chunk> aChunks;
+		size_t aSamplesChunk = 0;
+		uint64_t aSamplesOffset = 0; // Of the first sample in the file
+		uint64_t aSamplesSize = 0;
+		PCMLayout aLayout = {0, 0, false, false};
+		unsigned aNumChannels = 0;
+		PCMFileScrubber(std::string file);
+		// Fills in the chunks and everything about the samples, reporting its own errors
+		virtual bool parse() = 0;
+		// The body of the chunk at index in a scrubbed file of fileSize bytes, or false to drop the chunk; for the
+		// samples chunk, only what comes before the samples. It is first called with a fileSize of 0 to learn the
+		// size of every chunk, which must not depend on it.
+		virtual bool rebuildChunk(size_t index, uint64_t fileSize, std::vector<uint8_t> & body) = 0;
+		virtual void appendFileHeader(std::vector<uint8_t> & out, uint64_t fileSize) = 0;
+		virtual void appendChunkHeader(std::vector<uint8_t> & out, uint32_t id, uint64_t size) = 0;
+		void error(std::string errorMessage);
+		void error(bool condition, std::string errorMessage);
+		static uint16_t readLE16(const uint8_t * bytes);
+		static uint32_t readLE32(const uint8_t * bytes);
+		static uint64_t readLE64(const uint8_t * bytes);
+		static uint16_t readBE16(const uint8_t * bytes);
+		static uint32_t readBE32(const uint8_t * bytes);
+		static void appendLE32(std::vector<uint8_t> & out, uint32_t value);
+		static void appendLE64(std::vector<uint8_t> & out, uint64_t value);
+		static void appendBE32(std::vector<uint8_t> & out, uint32_t value);
+	private:
+		ScrubEngine aEngine;
+		FLACScrubberSync aSync = FLACSCRUBBER_DEFAULT_SYNC;
+		bool aTagsOnly = false;
+		int64_t aTotalSamples = 0;
+		AsyncFileWriter aWriter;
+		std::string aOriginalFile;
+		std::string aScrubbedFile;
+		ScrubReporter aReporter;
+		bool writeSamples();
+		void showProgress(int64_t currentSample);
+		PCMFileScrubber(const PCMFileScrubber &) = delete;
+		PCMFileScrubber & operator=(const PCMFileScrubber &) = delete;
+};
+
+#endif // PCMFILESCRUBBER_H
@@ -0,0 +1,148 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include "scrubcheckpoint.h"
+#include "asyncfilewriter.h"
+
+#define SCRUBCHECKPOINT_MAGIC "ASCRCKPT"
+
+// The checkpoint is only ever read back by the same build on the same machine, so its structures are stored as they are in memory
+struct ScrubCheckpointHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t stateSize;
+	uint64_t parameters;
+	uint64_t identity[3];
+	uint32_t numSeekPoints;
+};
+
+static uint64_t hash(const void * data, size_t length, uint64_t hash = 14695981039346656037ull) {
+	// FNV-1a, as in ScrubStamp
+	const unsigned char * bytes = (const unsigned char *) data;
+	for(size_t i = 0; i < length; i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+ScrubCheckpoint::ScrubCheckpoint(std::string file, std::string parameters) : aFile(file), aPath(getPath(file)) {
+	aParameters = hash(parameters.data(), parameters.size());
+}
+
+bool ScrubCheckpoint::load(State * state, std::vector<FLAC__StreamMetadata_SeekPoint> * seekPoints) {
+	int descriptor = open(aPath.c_str(), O_RDONLY);
+	if(descriptor == -1) {
+		return false;
+	}
+	std::vector<char> contents;
+	char buffer[4096];
+	ssize_t length;
+	while((length = read(descriptor, buffer, sizeof(buffer))) > 0) {
+		contents.insert(contents.end(), buffer, buffer + length);
+	}
+	close(descriptor);
+	ScrubCheckpointHeader header;
+	uint64_t identity[3];
+	if(length < 0 || contents.size() < sizeof(header) + sizeof(State) + sizeof(uint64_t) || !getIdentity(identity)) {
+		return false;
+	}
+	memcpy(&header, &contents[0], sizeof(header));
+	size_t expectedSize = sizeof(header) + sizeof(State) + header.numSeekPoints * sizeof(FLAC__StreamMetadata_SeekPoint) + sizeof(uint64_t);
+	if(memcmp(header.magic, SCRUBCHECKPOINT_MAGIC, sizeof(header.magic)) != 0 || header.version != SCRUBCHECKPOINT_VERSION || header.stateSize != sizeof(State) || contents.size() != expectedSize) {
+		return false;
+	}
+	uint64_t checksum;
+	memcpy(&checksum, &contents[expectedSize - sizeof(checksum)], sizeof(checksum));
+	if(checksum != hash(&contents[0], expectedSize - sizeof(checksum)) || header.parameters != aParameters || memcmp(header.identity, identity, sizeof(identity)) != 0) {
+		return false;
+	}
+	memcpy(state, &contents[sizeof(header)], sizeof(State));
+	seekPoints->resize(header.numSeekPoints);
+	if(header.numSeekPoints > 0) {
+		memcpy(&(*seekPoints)[0], &contents[sizeof(header) + sizeof(State)], header.numSeekPoints * sizeof(FLAC__StreamMetadata_SeekPoint));
+	}
+	return true;
+}
+
+bool ScrubCheckpoint::save(const State & state, const std::vector<FLAC__StreamMetadata_SeekPoint> & seekPoints) {
+	ScrubCheckpointHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SCRUBCHECKPOINT_MAGIC, sizeof(header.magic));
+	header.version = SCRUBCHECKPOINT_VERSION;
+	header.stateSize = sizeof(State);
+	header.parameters = aParameters;
+	header.numSeekPoints = seekPoints.size();
+	if(!getIdentity(header.identity)) {
+		return false;
+	}
+	std::vector<char> contents((const char *) &header, (const char *) (&header + 1));
+	contents.insert(contents.end(), (const char *) &state, (const char *) (&state + 1));
+	if(!seekPoints.empty()) {
+		contents.insert(contents.end(), (const char *) &seekPoints[0], (const char *) (&seekPoints[0] + seekPoints.size()));
+	}
+	uint64_t checksum = hash(&contents[0], contents.size());
+	contents.insert(contents.end(), (const char *) &checksum, (const char *) (&checksum + 1));
+	// Written aside and renamed over the previous checkpoint, so that a crash leaves one or the other
+	std::string temporaryPath = aPath + ".tmp";
+	int descriptor = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if(descriptor == -1) {
+		return false;
+	}
+	bool success = write(descriptor, &contents[0], contents.size()) == (ssize_t) contents.size() && fdatasync(descriptor) == 0;
+	success = close(descriptor) == 0 && success;
+	if(!success || std::rename(temporaryPath.c_str(), aPath.c_str()) != 0) {
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+	return AsyncFileWriter::syncDirectory(aPath);
+}
+
+void ScrubCheckpoint::remove() {
+	std::remove(aPath.c_str());
+}
+
+std::string ScrubCheckpoint::getPath(std::string file) {
+	return file + SCRUBCHECKPOINT_SUFFIX;
+}
+
+bool ScrubCheckpoint::getIdentity(uint64_t identity[3]) {
+	// Replacing or editing the original in between makes the checkpoint worthless
+	struct stat status;
+	if(stat(aFile.c_str(), &status) != 0) {
+		return false;
+	}
+	identity[0] = status.st_ino;
+	identity[1] = status.st_size;
+	identity[2] = (uint64_t) status.st_mtim.tv_sec * 1000000000ull + status.st_mtim.tv_nsec;
+	return true;
+}
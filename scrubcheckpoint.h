@@ -0,0 +1,72 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef SCRUBCHECKPOINT_H
+#define SCRUBCHECKPOINT_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "FLAC/format.h"
+#include "flacstreamwriter.h"
+#include "md5.h"
+
+// Appended to the name of a file to get the name of its checkpoint
+#define SCRUBCHECKPOINT_SUFFIX ".checkpoint"
+#define SCRUBCHECKPOINT_VERSION 1
+
+// Where the scrubbing of a long file stood the last time its scrubbed version was flushed to disk,
+// so that a run cut short can carry on from there and still produce the very same file. Scrubbing
+// is done segment by segment, so resuming only needs the state of the writer and of both MD5
+// signatures at a segment boundary, and the seed; the random offsets depend on nothing else.
+// The checkpoint is kept next to the file and replaced atomically, so there is always a complete
+// one; it is only trusted if the parameters and the original file are the same as when it was saved.
+class ScrubCheckpoint
+{
+	public:
+		struct State {
+			uint64_t seed;
+			unsigned segments; // Segments committed to the scrubbed file
+			FLACStreamWriter::State writer;
+			MD5::State originalMD5;
+			MD5::State scrubbedMD5;
+		};
+		// parameters describes everything that affects the scrubbed output, as for ScrubStamp
+		ScrubCheckpoint(std::string file, std::string parameters);
+		bool load(State * state, std::vector<FLAC__StreamMetadata_SeekPoint> * seekPoints);
+		bool save(const State & state, const std::vector<FLAC__StreamMetadata_SeekPoint> & seekPoints);
+		void remove();
+		static std::string getPath(std::string file);
+	private:
+		std::string aFile;
+		std::string aPath;
+		uint64_t aParameters; // Hash of the parameters
+		bool getIdentity(uint64_t identity[3]);
+};
+
+#endif // SCRUBCHECKPOINT_H
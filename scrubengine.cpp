@@ -0,0 +1,211 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <sstream>
+#include <vector>
+#include "scrubengine.h"
+
+ScrubEngine::ScrubEngine() {
+	aSeed = ScrubRandom::randomSeed();
+	// The generator is stateless once seeded, so all threads can share it
+	aRandom.seed(aSeed);
+}
+
+void ScrubEngine::setForceNonZero(bool forceNonZero) {
+	aForceNonZero = forceNonZero;
+}
+
+void ScrubEngine::scrubFirstSamples(int maxOffset) {
+	aFirstSamplesMaxOffset = maxOffset;
+}
+
+void ScrubEngine::scrubLastSamples(int maxOffset) {
+	aLastSamplesMaxOffset = maxOffset;
+}
+
+void ScrubEngine::scrubOtherSamples(int maxOffset) {
+	aOtherSamplesMaxOffset = maxOffset;
+}
+
+void ScrubEngine::setFirstSamplesSize(int samples) {
+	aFirstSamplesSize = samples;
+}
+
+void ScrubEngine::setLastSamplesSize(int samples) {
+	aLastSamplesSize = samples;
+}
+
+void ScrubEngine::setFirstSamplesScrubRate(float rate) {
+	aFirstSamplesScrubRate = rate;
+}
+
+void ScrubEngine::setLastSamplesScrubRate(float rate) {
+	aLastSamplesScrubRate = rate;
+}
+
+void ScrubEngine::setOtherSamplesScrubRate(float rate) {
+	aOtherSamplesScrubRate = rate;
+}
+
+void ScrubEngine::setSeed(uint64_t seed) {
+	restoreSeed(seed);
+	aSeedSet = true;
+}
+
+void ScrubEngine::restoreSeed(uint64_t seed) {
+	aSeed = seed;
+	aRandom.seed(aSeed);
+}
+
+uint64_t ScrubEngine::getSeed() {
+	return aSeed;
+}
+
+int ScrubEngine::getLastSamplesSize() {
+	return aLastSamplesSize;
+}
+
+std::string ScrubEngine::getParameters() {
+	std::ostringstream parameters;
+	parameters.precision(9);
+	parameters << "first=" << aFirstSamplesSize << "," << aFirstSamplesMaxOffset << "," << aFirstSamplesScrubRate;
+	parameters << ";last=" << aLastSamplesSize << "," << aLastSamplesMaxOffset << "," << aLastSamplesScrubRate;
+	parameters << ";other=" << aOtherSamplesMaxOffset << "," << aOtherSamplesScrubRate;
+	parameters << ";nonzero=" << aForceNonZero;
+	return parameters.str();
+}
+
+std::string ScrubEngine::getSeedParameter() {
+	std::ostringstream parameter;
+	if(aSeedSet) {
+		parameter << "seed=" << aSeed;
+	} else {
+		parameter << "seed=random";
+	}
+	return parameter.str();
+}
+
+void ScrubEngine::prepare(int64_t totalSamples, unsigned bitsPerSample, unsigned numChannels) {
+	aParameters.random = &aRandom;
+	aParameters.firstRegion = makeScrubRegion(aFirstSamplesMaxOffset, aFirstSamplesScrubRate, aForceNonZero);
+	aParameters.lastRegion = makeScrubRegion(aLastSamplesMaxOffset, aLastSamplesScrubRate, aForceNonZero);
+	if(aOtherSamplesMaxOffset) {
+		aParameters.otherRegion = makeScrubRegion(aOtherSamplesMaxOffset, aOtherSamplesScrubRate, aForceNonZero);
+	} else {
+		// Without an offset, the middle of the file is either left alone or shifted by one
+		aParameters.otherRegion = makeScrubRegion(0, 0, false);
+		aParameters.otherRegion.constant = aForceNonZero ? 1 : 0;
+	}
+	aParameters.firstSamplesEnd = (int64_t) aFirstSamplesSize + 1;
+	if(totalSamples > 0) {
+		setTotalSamples(totalSamples);
+	} else {
+		// Not known until the stream ends; see setTotalSamples
+		aParameters.lastSamplesStart = INT64_MAX;
+	}
+	int32_t maxSampleValue = (int32_t) (((int64_t) 1 << (bitsPerSample - 1)) - 1);
+	aParameters.minSampleValue = -maxSampleValue - 1;
+	aParameters.maxSampleValue = maxSampleValue;
+	selectScrubKernels(&aParameters);
+	aNumChannels = numChannels;
+	// Mono, stereo and 5.1 get their channel loop unrolled
+	switch(numChannels) {
+		case 1:
+			aScrub = &ScrubEngine::scrubFor<1>;
+			break;
+		case 2:
+			aScrub = &ScrubEngine::scrubFor<2>;
+			break;
+		case 6:
+			aScrub = &ScrubEngine::scrubFor<6>;
+			break;
+		default:
+			aScrub = &ScrubEngine::scrubFor<0>;
+	}
+}
+
+void ScrubEngine::setTotalSamples(int64_t totalSamples) {
+	aParameters.lastSamplesStart = totalSamples - aLastSamplesSize;
+}
+
+const ScrubKernelParameters & ScrubEngine::getKernelParameters() {
+	return aParameters;
+}
+
+void ScrubEngine::scrub(const int32_t * const in[], unsigned offset, unsigned count, int64_t firstSample, int32_t * const out[]) {
+	(this->*aScrub)(in, offset, count, firstSample, out);
+}
+
+// CHANNELS = 0 takes the number of channels from prepare()
+template<unsigned CHANNELS> void ScrubEngine::scrubFor(const int32_t * const in[], unsigned offset, unsigned count, int64_t firstSample, int32_t * const out[]) {
+	unsigned numChannels = CHANNELS ? CHANNELS : aNumChannels;
+	// Split the samples once into runs that lie within a single region (at most three of them),
+	// then have that region's kernel scrub each channel straight into its output plane
+	unsigned done = 0;
+	while(done < count) {
+		const ScrubRegion * region;
+		unsigned spanCount = getScrubRegionSpan(&aParameters, firstSample + done, count - done, &region);
+		for(unsigned channel = 0; channel < numChannels; channel++) {
+			region->kernel(&aParameters, region, in[channel] + offset + done, out[channel] + done, spanCount, firstSample + done, channel);
+		}
+		done += spanCount;
+	}
+}
+
+bool ScrubEngine::process(AudioSource * source, AudioSink * sink, std::function<void(int64_t)> progress) {
+	AudioFormat format = source->getFormat();
+	prepare(format.totalSamples, format.bitsPerSample, format.numChannels);
+	AlignedBuffer<int32_t> samples;
+	AlignedBuffer<int32_t> scrubbedSamples;
+	samples.reserve(format.numChannels * SCRUBENGINE_BLOCK_SAMPLES);
+	scrubbedSamples.reserve(format.numChannels * SCRUBENGINE_BLOCK_SAMPLES);
+	std::vector<int32_t *> channels(format.numChannels);
+	std::vector<int32_t *> scrubbedChannels(format.numChannels);
+	for(unsigned channel = 0; channel < format.numChannels; channel++) {
+		channels[channel] = samples.data() + channel * SCRUBENGINE_BLOCK_SAMPLES;
+		scrubbedChannels[channel] = scrubbedSamples.data() + channel * SCRUBENGINE_BLOCK_SAMPLES;
+	}
+	int64_t firstSample = 0;
+	for(;;) {
+		int64_t count = source->read(&channels[0], SCRUBENGINE_BLOCK_SAMPLES);
+		if(count < 0) {
+			return false;
+		}
+		if(count == 0) {
+			return true;
+		}
+		scrub(&channels[0], 0, (unsigned) count, firstSample, &scrubbedChannels[0]);
+		if(!sink->write(&scrubbedChannels[0], (unsigned) count)) {
+			return false;
+		}
+		firstSample += count;
+		if(progress) {
+			progress(firstSample);
+		}
+	}
+}
@@ -0,0 +1,112 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef SCRUBENGINE_H
+#define SCRUBENGINE_H
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include "alignedbuffer.h"
+#include "audiosink.h"
+#include "audiosource.h"
+#include "scrubkernel.h"
+#include "scrubrandom.h"
+
+#define SCRUBENGINE_DEFAULT_FORCENONZERO false
+#define SCRUBENGINE_DEFAULT_FIRSTSAMPLESIZE 4096
+#define SCRUBENGINE_DEFAULT_LASTSAMPLESIZE 2048
+#define SCRUBENGINE_DEFAULT_FIRSTSAMPLESSCRUBRATE 1
+#define SCRUBENGINE_DEFAULT_LASTSAMPLESSCRUBRATE 1
+#define SCRUBENGINE_DEFAULT_OTHERSAMPLESSCRUBRATE 0.2
+#define SCRUBENGINE_DEFAULT_FIRSTSAMPLESMAXOFFSET 256
+#define SCRUBENGINE_DEFAULT_LASTSAMPLESMAXOFFSET 256
+#define SCRUBENGINE_DEFAULT_OTHERSAMPLESMAXOFFSET 2
+
+// Sample frames per block in process()
+#define SCRUBENGINE_BLOCK_SAMPLES 4096
+
+// The scrubbing itself, independent of any file format: the options, the seed, and the windows at the
+// beginning and end of the stream, applied by the scrub kernels to planar blocks of 32-bit samples.
+// Each format feeds it in whatever way is fastest for it, either block by block through scrub(), or
+// by handing a source and a sink to process().
+class ScrubEngine
+{
+	public:
+		ScrubEngine();
+		void setForceNonZero(bool forceNonZero);
+		void scrubFirstSamples(int maxOffset);
+		void scrubLastSamples(int maxOffset);
+		void scrubOtherSamples(int maxOffset);
+		void setFirstSamplesSize(int samples);
+		void setLastSamplesSize(int samples);
+		void setFirstSamplesScrubRate(float rate);
+		void setLastSamplesScrubRate(float rate);
+		void setOtherSamplesScrubRate(float rate);
+		// Makes the output reproducible; otherwise every engine draws a random seed of its own
+		void setSeed(uint64_t seed);
+		// Carries on with the seed of an earlier run, such as one resumed from a checkpoint, without it becoming an option
+		void restoreSeed(uint64_t seed);
+		uint64_t getSeed();
+		int getLastSamplesSize();
+		// Every option that affects the output, other than the seed; see getSeedParameter
+		std::string getParameters();
+		// The seed if it was set, or that it is random, since then any seed is as good as another
+		std::string getSeedParameter();
+		// Must be called before scrubbing a stream; totalSamples is 0 or less if the length is not known yet
+		void prepare(int64_t totalSamples, unsigned bitsPerSample, unsigned numChannels);
+		// For streams whose length only becomes known along the way, before any of their last samples are scrubbed
+		void setTotalSamples(int64_t totalSamples);
+		const ScrubKernelParameters & getKernelParameters();
+		// Scrubs count sample frames of every channel, read from offset in each input plane and written to the start of each output plane
+		void scrub(const int32_t * const in[], unsigned offset, unsigned count, int64_t firstSample, int32_t * const out[]);
+		// Scrubs a whole stream; progress, if any, gets the number of sample frames done after each block.
+		// The last samples window only applies if the source knows its length.
+		bool process(AudioSource * source, AudioSink * sink, std::function<void(int64_t)> progress);
+	private:
+		bool aForceNonZero = SCRUBENGINE_DEFAULT_FORCENONZERO;
+		int aFirstSamplesSize = SCRUBENGINE_DEFAULT_FIRSTSAMPLESIZE;
+		int aLastSamplesSize = SCRUBENGINE_DEFAULT_LASTSAMPLESIZE;
+		float aFirstSamplesScrubRate = SCRUBENGINE_DEFAULT_FIRSTSAMPLESSCRUBRATE;
+		float aLastSamplesScrubRate = SCRUBENGINE_DEFAULT_LASTSAMPLESSCRUBRATE;
+		float aOtherSamplesScrubRate = SCRUBENGINE_DEFAULT_OTHERSAMPLESSCRUBRATE;
+		int aFirstSamplesMaxOffset = SCRUBENGINE_DEFAULT_FIRSTSAMPLESMAXOFFSET;
+		int aLastSamplesMaxOffset = SCRUBENGINE_DEFAULT_LASTSAMPLESMAXOFFSET;
+		int aOtherSamplesMaxOffset = SCRUBENGINE_DEFAULT_OTHERSAMPLESMAXOFFSET;
+		uint64_t aSeed;
+		bool aSeedSet = false;
+		ScrubRandom aRandom;
+		ScrubKernelParameters aParameters;
+		unsigned aNumChannels = 0;
+		void (ScrubEngine::* aScrub)(const int32_t * const in[], unsigned offset, unsigned count, int64_t firstSample, int32_t * const out[]) = &ScrubEngine::scrubFor<0>;
+		template<unsigned CHANNELS> void scrubFor(const int32_t * const in[], unsigned offset, unsigned count, int64_t firstSample, int32_t * const out[]);
+		ScrubEngine(const ScrubEngine &) = delete;
+		ScrubEngine & operator=(const ScrubEngine &) = delete;
+};
+
+#endif // SCRUBENGINE_H
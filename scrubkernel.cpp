@@ -0,0 +1,276 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <math.h>
+#include <string.h>
+#include "scrubkernel.h"
+
+ScrubRegion makeScrubRegion(int maxOffset, float rate, bool forceNonZero) {
+	ScrubRegion region;
+	// (word >> 8) / 2^24 < rate exactly when (word >> 8) < ceil(rate * 2^24)
+	if(rate <= 0.f) {
+		region.threshold = 0;
+	} else if(rate >= 1.f) {
+		region.threshold = 1 << 24;
+	} else {
+		region.threshold = (uint32_t) ceil((double) rate * (double) (1 << 24));
+	}
+	if(forceNonZero) {
+		region.base = 1;
+		region.range = maxOffset <= 1 ? 0 : maxOffset - 1;
+	} else {
+		region.base = 0;
+		region.range = maxOffset <= 0 ? 0 : maxOffset;
+	}
+	region.constant = 0;
+	// At low rates most random draws would be thrown away, so jump straight to the samples that get scrubbed
+	region.sparse = rate > 0.f && rate <= SCRUBKERNEL_SPARSE_MAX_RATE;
+	double skipProbability = 1.;
+	for(int k = 0; k < SCRUBKERNEL_SPARSE_TABLE_SIZE; k++) {
+		skipProbability *= 1. - (double) rate;
+		// For a tiny rate, 1 - rate rounds to 1 and the threshold to 2^32, which does not fit
+		double threshold = skipProbability * 4294967296.;
+		region.skipThresholds[k] = region.sparse ? (threshold >= (double) UINT32_MAX ? UINT32_MAX : (uint32_t) threshold) : 0;
+	}
+	region.kernel = scrubKernelScalar;
+	return region;
+}
+
+// Clamping bounds, known at compile time for the common bit depths; BITS = 0 reads them from the parameters
+template<int BITS> struct SampleBounds {
+	static inline int32_t minValue(const ScrubKernelParameters * parameters) {
+		return -(1 << (BITS - 1));
+	}
+	static inline int32_t maxValue(const ScrubKernelParameters * parameters) {
+		return (1 << (BITS - 1)) - 1;
+	}
+};
+
+template<> struct SampleBounds<0> {
+	static inline int32_t minValue(const ScrubKernelParameters * parameters) {
+		return parameters->minSampleValue;
+	}
+	static inline int32_t maxValue(const ScrubKernelParameters * parameters) {
+		return parameters->maxSampleValue;
+	}
+};
+
+template<int BITS> static inline int32_t clampSample(const ScrubKernelParameters * parameters, int64_t sample) {
+	if(sample > SampleBounds<BITS>::maxValue(parameters)) {
+		return SampleBounds<BITS>::maxValue(parameters);
+	}
+	if(sample < SampleBounds<BITS>::minValue(parameters)) {
+		return SampleBounds<BITS>::minValue(parameters);
+	}
+	return (int32_t) sample;
+}
+
+template<int BITS> static void scrubConstant(const ScrubKernelParameters * parameters, const ScrubRegion * region, const int32_t * in, int32_t * out, unsigned count, int64_t firstSample, uint32_t channel) {
+	if(!region->constant) {
+		if(in != out) {
+			memcpy(out, in, count * sizeof(int32_t));
+		}
+		return;
+	}
+	for(unsigned i = 0; i < count; i++) {
+		out[i] = clampSample<BITS>(parameters, (int64_t) in[i] + region->constant);
+	}
+}
+
+void scrubKernelConstant(const ScrubKernelParameters * parameters, const ScrubRegion * region, const int32_t * in, int32_t * out, unsigned count, int64_t firstSample, uint32_t channel) {
+	scrubConstant<0>(parameters, region, in, out, count, firstSample, channel);
+}
+
+template<int BITS> static void scrubScalar(const ScrubKernelParameters * parameters, const ScrubRegion * region, const int32_t * in, int32_t * out, unsigned count, int64_t firstSample, uint32_t channel) {
+	const ScrubRandom * random = parameters->random;
+	for(unsigned i = 0; i < count; i++) {
+		int64_t sampleNumber = firstSample + i;
+		int64_t offset = region->constant;
+		if(region->threshold) {
+			// Word 0 decides whether the sample is scrubbed, word 1 gives the sign, word 2 the magnitude
+			uint32_t words[4];
+			random->generate(sampleNumber, channel, 0, words);
+			if((words[0] >> 8) < region->threshold) {
+				offset = (int64_t) region->base + random->bounded(region->range, words[2], sampleNumber, channel);
+				if(words[1] & 1) {
+					offset = -offset;
+				}
+			}
+		}
+		out[i] = clampSample<BITS>(parameters, in[i] + offset);
+	}
+}
+
+void scrubKernelScalar(const ScrubKernelParameters * parameters, const ScrubRegion * region, const int32_t * in, int32_t * out, unsigned count, int64_t firstSample, uint32_t channel) {
+	scrubScalar<0>(parameters, region, in, out, count, firstSample, channel);
+}
+
+// Random words for the sparse path are consumed in order from consecutive blocks of a separate counter domain
+static inline uint32_t nextSparseWord(const ScrubRandom * random, int64_t chunk, uint32_t channel, uint32_t * block, uint32_t words[4], unsigned * used) {
+	if(*used == 4) {
+		random->generate(chunk, channel, SCRUBKERNEL_SPARSE_DOMAIN | (*block)++, words);
+		*used = 0;
+	}
+	return words[(*used)++];
+}
+
+// Gaps restart at every SCRUBKERNEL_SPARSE_CHUNK boundary, so that which samples get scrubbed
+// only depends on (seed, sample number, channel) and not on where the span starts.
+// Each gap takes one word, looked up in the region's inverse CDF table; gaps longer than the table
+// are covered by skipping the whole table and drawing again, which is exact since the distribution is memoryless.
+// Each scrubbed sample then takes one more word: its low bit for the sign, the rest for the magnitude.
+template<int BITS> static void scrubSparse(const ScrubKernelParameters * parameters, const ScrubRegion * region, const int32_t * in, int32_t * out, unsigned count, int64_t firstSample, uint32_t channel) {
+	if(in != out) {
+		memcpy(out, in, count * sizeof(int32_t));
+	}
+	const ScrubRandom * random = parameters->random;
+	const uint32_t * thresholds = region->skipThresholds;
+	int64_t end = firstSample + count;
+	for(int64_t chunkStart = firstSample - firstSample % SCRUBKERNEL_SPARSE_CHUNK; chunkStart < end; chunkStart += SCRUBKERNEL_SPARSE_CHUNK) {
+		int64_t chunk = chunkStart / SCRUBKERNEL_SPARSE_CHUNK;
+		int64_t chunkEnd = chunkStart + SCRUBKERNEL_SPARSE_CHUNK < end ? chunkStart + SCRUBKERNEL_SPARSE_CHUNK : end;
+		uint32_t words[4];
+		uint32_t block = 0;
+		unsigned used = 4;
+		int64_t sampleNumber = chunkStart;
+		while(true) {
+			uint32_t word = nextSparseWord(random, chunk, channel, &block, words, &used);
+			// Count the leading thresholds above word
+			unsigned gap = 0;
+			for(unsigned step = SCRUBKERNEL_SPARSE_TABLE_SIZE / 2; step; step >>= 1) {
+				if(word < thresholds[gap + step - 1]) {
+					gap += step;
+				}
+			}
+			if(gap == SCRUBKERNEL_SPARSE_TABLE_SIZE - 1 && word < thresholds[gap]) {
+				sampleNumber += SCRUBKERNEL_SPARSE_TABLE_SIZE;
+				if(sampleNumber >= chunkEnd) {
+					break;
+				}
+				continue;
+			}
+			sampleNumber += gap;
+			if(sampleNumber >= chunkEnd) {
+				break;
+			}
+			word = nextSparseWord(random, chunk, channel, &block, words, &used);
+			if(sampleNumber >= firstSample) {
+				int64_t offset = (int64_t) region->base + random->bounded(region->range, word, sampleNumber, channel);
+				if(word & 1) {
+					offset = -offset;
+				}
+				out[sampleNumber - firstSample] = clampSample<BITS>(parameters, in[sampleNumber - firstSample] + offset);
+			}
+			sampleNumber++;
+		}
+	}
+}
+
+void scrubKernelSparse(const ScrubKernelParameters * parameters, const ScrubRegion * region, const int32_t * in, int32_t * out, unsigned count, int64_t firstSample, uint32_t channel) {
+	scrubSparse<0>(parameters, region, in, out, count, firstSample, channel);
+}
+
+unsigned getScrubRegionSpan(const ScrubKernelParameters * parameters, int64_t firstSample, unsigned count, const ScrubRegion ** region) {
+	int64_t regionEnd;
+	if(firstSample < parameters->firstSamplesEnd) {
+		*region = &parameters->firstRegion;
+		regionEnd = parameters->firstSamplesEnd;
+	} else if(firstSample >= parameters->lastSamplesStart) {
+		*region = &parameters->lastRegion;
+		return count;
+	} else {
+		*region = &parameters->otherRegion;
+		regionEnd = parameters->lastSamplesStart;
+	}
+	return regionEnd - firstSample < count ? (unsigned) (regionEnd - firstSample) : count;
+}
+
+// Bit depth for which the clamping bounds are compiled in, or 0 if they are not
+static int getCompiledBits(const ScrubKernelParameters * parameters) {
+	if(parameters->minSampleValue == SampleBounds<16>::minValue(parameters) && parameters->maxSampleValue == SampleBounds<16>::maxValue(parameters)) {
+		return 16;
+	}
+	if(parameters->minSampleValue == SampleBounds<24>::minValue(parameters) && parameters->maxSampleValue == SampleBounds<24>::maxValue(parameters)) {
+		return 24;
+	}
+	return 0;
+}
+
+template<int BITS> static ScrubKernel selectKernel(const ScrubKernelParameters * parameters, const ScrubRegion & region) {
+	if(!region.threshold) {
+		return scrubConstant<BITS>;
+	}
+	if(region.sparse) {
+		return scrubSparse<BITS>;
+	}
+	// The vectorized kernels add offsets in 32 bits; make sure that cannot overflow
+	int64_t offset = (int64_t) region.base + region.range;
+	int64_t constant = region.constant < 0 ? -(int64_t) region.constant : region.constant;
+	if(constant > offset) {
+		offset = constant;
+	}
+	int64_t sample = -(int64_t) parameters->minSampleValue;
+	if(parameters->maxSampleValue > sample) {
+		sample = parameters->maxSampleValue;
+	}
+	if(sample + offset > INT32_MAX) {
+		return scrubScalar<BITS>;
+	}
+#ifdef ASCRUBBER_X86_SIMD
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx512f")) {
+		return scrubKernelAvx512;
+	}
+	if(__builtin_cpu_supports("avx2")) {
+		return scrubKernelAvx2;
+	}
+	if(__builtin_cpu_supports("sse4.1")) {
+		return scrubKernelSse41;
+	}
+#endif
+	return scrubScalar<BITS>;
+}
+
+template<int BITS> static void selectKernels(ScrubKernelParameters * parameters) {
+	parameters->firstRegion.kernel = selectKernel<BITS>(parameters, parameters->firstRegion);
+	parameters->lastRegion.kernel = selectKernel<BITS>(parameters, parameters->lastRegion);
+	parameters->otherRegion.kernel = selectKernel<BITS>(parameters, parameters->otherRegion);
+}
+
+void selectScrubKernels(ScrubKernelParameters * parameters) {
+	switch(getCompiledBits(parameters)) {
+		case 16:
+			selectKernels<16>(parameters);
+			break;
+		case 24:
+			selectKernels<24>(parameters);
+			break;
+		default:
+			selectKernels<0>(parameters);
+	}
+}
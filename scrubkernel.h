@@ -0,0 +1,92 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef SCRUBKERNEL_H
+#define SCRUBKERNEL_H
+
+#include <stdint.h>
+#include "scrubrandom.h"
+
+#define SCRUBKERNEL_SPARSE_MAX_RATE 0.25
+#define SCRUBKERNEL_SPARSE_CHUNK 4096
+#define SCRUBKERNEL_SPARSE_DOMAIN 0x80000000
+#define SCRUBKERNEL_SPARSE_TABLE_SIZE 64
+
+struct ScrubRegion;
+struct ScrubKernelParameters;
+
+// Scrubs count consecutive samples of one channel, starting at sample number firstSample, all within region
+typedef void (* ScrubKernel)(const ScrubKernelParameters * parameters, const ScrubRegion * region, const int32_t * in, int32_t * out, unsigned count, int64_t firstSample, uint32_t channel);
+
+// How the samples of one region (beginning, end or middle of the file) are offset.
+// A sample is scrubbed if the top 24 bits of its first random word are below threshold;
+// it is then offset by +/- (base + a uniform number in [0, range)). Other samples are offset by constant.
+// Sparse regions instead skip from one scrubbed sample to the next by geometrically distributed gaps.
+struct ScrubRegion {
+	uint32_t threshold;
+	uint32_t base;
+	uint32_t range;
+	int32_t constant;
+	bool sparse;
+	// For sparse regions, entry k is floor((1 - rate)^(k + 1) * 2^32): a gap is at least k + 1 samples long
+	// when its random word is below it
+	uint32_t skipThresholds[SCRUBKERNEL_SPARSE_TABLE_SIZE];
+	ScrubKernel kernel; // Set by selectScrubKernels
+};
+
+struct ScrubKernelParameters {
+	const ScrubRandom * random;
+	ScrubRegion firstRegion;
+	ScrubRegion lastRegion;
+	ScrubRegion otherRegion;
+	int64_t firstSamplesEnd; // Samples before this one are in the first region
+	int64_t lastSamplesStart; // Samples from this one on are in the last region, unless they are in the first one
+	int32_t minSampleValue;
+	int32_t maxSampleValue;
+};
+
+ScrubRegion makeScrubRegion(int maxOffset, float rate, bool forceNonZero);
+// Picks the fastest kernel for each region, given its parameters and what the CPU supports
+void selectScrubKernels(ScrubKernelParameters * parameters);
+// Finds the region of firstSample and returns how many of the count samples from there on are in it
+unsigned getScrubRegionSpan(const ScrubKernelParameters * parameters, int64_t firstSample, unsigned count, const ScrubRegion ** region);
+
+// Regions that never draw random numbers
+void scrubKernelConstant(const ScrubKernelParameters * parameters, const ScrubRegion * region, const int32_t * in, int32_t * out, unsigned count, int64_t firstSample, uint32_t channel);
+// Sparse regions
+void scrubKernelSparse(const ScrubKernelParameters * parameters, const ScrubRegion * region, const int32_t * in, int32_t * out, unsigned count, int64_t firstSample, uint32_t channel);
+// Reference implementation for the other regions; the vectorized kernels must produce exactly the same output
+void scrubKernelScalar(const ScrubKernelParameters * parameters, const ScrubRegion * region, const int32_t * in, int32_t * out, unsigned count, int64_t firstSample, uint32_t channel);
+
+#ifdef ASCRUBBER_X86_SIMD
+void scrubKernelSse41(const ScrubKernelParameters * parameters, const ScrubRegion * region, const int32_t * in, int32_t * out, unsigned count, int64_t firstSample, uint32_t channel);
+void scrubKernelAvx2(const ScrubKernelParameters * parameters, const ScrubRegion * region, const int32_t * in, int32_t * out, unsigned count, int64_t firstSample, uint32_t channel);
+void scrubKernelAvx512(const ScrubKernelParameters * parameters, const ScrubRegion * region, const int32_t * in, int32_t * out, unsigned count, int64_t firstSample, uint32_t channel);
+#endif
+
+#endif // SCRUBKERNEL_H
@@ -0,0 +1,105 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+// Compiled with -mavx2
+#include <immintrin.h>
+#include "scrubkernelsimd.h"
+
+namespace {
+
+struct Avx2Vectors {
+	typedef __m256i Vector;
+	typedef __m256i Mask;
+	static const unsigned LANES = 8;
+	static inline Vector set1(uint32_t value) {
+		return _mm256_set1_epi32((int) value);
+	}
+	static inline Vector laneIndices() {
+		return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	}
+	static inline Vector load(const int32_t * data) {
+		return _mm256_loadu_si256((const __m256i *) data);
+	}
+	static inline void store(int32_t * data, Vector value) {
+		_mm256_storeu_si256((__m256i *) data, value);
+	}
+	static inline Vector add(Vector a, Vector b) {
+		return _mm256_add_epi32(a, b);
+	}
+	static inline Vector sub(Vector a, Vector b) {
+		return _mm256_sub_epi32(a, b);
+	}
+	static inline Vector bitAnd(Vector a, Vector b) {
+		return _mm256_and_si256(a, b);
+	}
+	static inline Vector bitXor(Vector a, Vector b) {
+		return _mm256_xor_si256(a, b);
+	}
+	static inline Vector shiftRight8(Vector a) {
+		return _mm256_srli_epi32(a, 8);
+	}
+	static inline Vector min(Vector a, Vector b) {
+		return _mm256_min_epi32(a, b);
+	}
+	static inline Vector max(Vector a, Vector b) {
+		return _mm256_max_epi32(a, b);
+	}
+	// Full 32x32 -> 64 bit products, split into their high and low halves
+	static inline void multiply(Vector a, Vector b, Vector & high, Vector & low) {
+		Vector even = _mm256_mul_epu32(a, b);
+		Vector odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+		low = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+		high = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+	}
+	static inline Mask lessThan(Vector a, Vector b) {
+		return _mm256_cmpgt_epi32(b, a);
+	}
+	static inline Mask unsignedLessThan(Vector a, Vector b) {
+		const Vector bias = _mm256_set1_epi32((int) 0x80000000u);
+		return _mm256_cmpgt_epi32(_mm256_xor_si256(b, bias), _mm256_xor_si256(a, bias));
+	}
+	static inline Mask equal(Vector a, Vector b) {
+		return _mm256_cmpeq_epi32(a, b);
+	}
+	static inline Mask maskAnd(Mask a, Mask b) {
+		return _mm256_and_si256(a, b);
+	}
+	static inline int maskBits(Mask mask) {
+		return _mm256_movemask_ps(_mm256_castsi256_ps(mask));
+	}
+	// Lanes of b where mask is set, lanes of a elsewhere
+	static inline Vector blend(Vector a, Vector b, Mask mask) {
+		return _mm256_blendv_epi8(a, b, mask);
+	}
+};
+
+}
+
+void scrubKernelAvx2(const ScrubKernelParameters * parameters, const ScrubRegion * region, const int32_t * in, int32_t * out, unsigned count, int64_t firstSample, uint32_t channel) {
+	scrubKernelVectorized<Avx2Vectors>(parameters, region, in, out, count, firstSample, channel);
+}
@@ -0,0 +1,104 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+// Compiled with -mavx512f
+#include <immintrin.h>
+#include "scrubkernelsimd.h"
+
+namespace {
+
+struct Avx512Vectors {
+	typedef __m512i Vector;
+	typedef __mmask16 Mask;
+	static const unsigned LANES = 16;
+	static inline Vector set1(uint32_t value) {
+		return _mm512_set1_epi32((int) value);
+	}
+	static inline Vector laneIndices() {
+		return _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	}
+	static inline Vector load(const int32_t * data) {
+		return _mm512_loadu_si512((const void *) data);
+	}
+	static inline void store(int32_t * data, Vector value) {
+		_mm512_storeu_si512((void *) data, value);
+	}
+	static inline Vector add(Vector a, Vector b) {
+		return _mm512_add_epi32(a, b);
+	}
+	static inline Vector sub(Vector a, Vector b) {
+		return _mm512_sub_epi32(a, b);
+	}
+	static inline Vector bitAnd(Vector a, Vector b) {
+		return _mm512_and_si512(a, b);
+	}
+	static inline Vector bitXor(Vector a, Vector b) {
+		return _mm512_xor_si512(a, b);
+	}
+	static inline Vector shiftRight8(Vector a) {
+		return _mm512_srli_epi32(a, 8);
+	}
+	static inline Vector min(Vector a, Vector b) {
+		return _mm512_min_epi32(a, b);
+	}
+	static inline Vector max(Vector a, Vector b) {
+		return _mm512_max_epi32(a, b);
+	}
+	// Full 32x32 -> 64 bit products, split into their high and low halves
+	static inline void multiply(Vector a, Vector b, Vector & high, Vector & low) {
+		Vector even = _mm512_mul_epu32(a, b);
+		Vector odd = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), _mm512_srli_epi64(b, 32));
+		low = _mm512_mask_blend_epi32(0xAAAA, even, _mm512_slli_epi64(odd, 32));
+		high = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 32), odd);
+	}
+	static inline Mask lessThan(Vector a, Vector b) {
+		return _mm512_cmplt_epi32_mask(a, b);
+	}
+	static inline Mask unsignedLessThan(Vector a, Vector b) {
+		return _mm512_cmplt_epu32_mask(a, b);
+	}
+	static inline Mask equal(Vector a, Vector b) {
+		return _mm512_cmpeq_epi32_mask(a, b);
+	}
+	static inline Mask maskAnd(Mask a, Mask b) {
+		return a & b;
+	}
+	static inline int maskBits(Mask mask) {
+		return mask;
+	}
+	// Lanes of b where mask is set, lanes of a elsewhere
+	static inline Vector blend(Vector a, Vector b, Mask mask) {
+		return _mm512_mask_blend_epi32(mask, a, b);
+	}
+};
+
+}
+
+void scrubKernelAvx512(const ScrubKernelParameters * parameters, const ScrubRegion * region, const int32_t * in, int32_t * out, unsigned count, int64_t firstSample, uint32_t channel) {
+	scrubKernelVectorized<Avx512Vectors>(parameters, region, in, out, count, firstSample, channel);
+}
@@ -0,0 +1,119 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef SCRUBKERNELSIMD_H
+#define SCRUBKERNELSIMD_H
+
+#include "scrubkernel.h"
+
+// Vectorized version of scrubKernelScalar, written once against a small set of vector operations.
+// Each instruction set provides those operations in its own source file, compiled with the matching
+// compiler flags; everything here has internal linkage so that the instantiations cannot be mixed up
+// at link time.
+
+namespace {
+
+template<class V> inline void philox(typename V::Vector counter[4], uint32_t key0, uint32_t key1) {
+	typedef typename V::Vector Vector;
+	const Vector m0 = V::set1(SCRUBRANDOM_PHILOX_M0);
+	const Vector m1 = V::set1(SCRUBRANDOM_PHILOX_M1);
+	for(int round = 0; round < SCRUBRANDOM_PHILOX_ROUNDS; round++) {
+		Vector high0, low0, high1, low1;
+		V::multiply(counter[0], m0, high0, low0);
+		V::multiply(counter[2], m1, high1, low1);
+		counter[0] = V::bitXor(V::bitXor(high1, counter[1]), V::set1(key0));
+		counter[1] = low1;
+		counter[2] = V::bitXor(V::bitXor(high0, counter[3]), V::set1(key1));
+		counter[3] = low0;
+		key0 += SCRUBRANDOM_PHILOX_W0;
+		key1 += SCRUBRANDOM_PHILOX_W1;
+	}
+}
+
+inline uint32_t rejectionThreshold(const ScrubRegion * region) {
+	return region->range ? -region->range % region->range : 0;
+}
+
+template<class V> void scrubKernelVectorized(const ScrubKernelParameters * parameters, const ScrubRegion * region, const int32_t * in, int32_t * out, unsigned count, int64_t firstSample, uint32_t channel) {
+	typedef typename V::Vector Vector;
+	typedef typename V::Mask Mask;
+	const ScrubRandom * random = parameters->random;
+	const Vector lanes = V::laneIndices();
+	const Vector zero = V::set1(0);
+	const Vector one = V::set1(1);
+	const Vector threshold = V::set1(region->threshold);
+	const Vector constant = V::set1(region->constant);
+	const Vector base = V::set1(region->base);
+	const Vector range = V::set1(region->range);
+	const Vector rejection = V::set1(rejectionThreshold(region));
+	const Vector minValue = V::set1(parameters->minSampleValue);
+	const Vector maxValue = V::set1(parameters->maxSampleValue);
+	const uint32_t key0 = random->getKey(0);
+	const uint32_t key1 = random->getKey(1);
+	unsigned i = 0;
+	for(; i + V::LANES <= count; i += V::LANES) {
+		int64_t sampleNumber = firstSample + i;
+		uint32_t low = (uint32_t) sampleNumber;
+		if(low > 0xFFFFFFFFu - (V::LANES - 1)) {
+			// The low word of the counter would wrap around within this vector
+			scrubKernelScalar(parameters, region, in + i, out + i, V::LANES, sampleNumber, channel);
+			continue;
+		}
+		Vector counter[4] = {V::add(V::set1(low), lanes), V::set1((uint32_t) (sampleNumber >> 32)), V::set1(channel), zero};
+		philox<V>(counter, key0, key1);
+		Mask scrubbed = V::lessThan(V::shiftRight8(counter[0]), threshold);
+		Vector high, lowProduct;
+		V::multiply(counter[2], range, high, lowProduct);
+		Vector magnitude = V::add(base, high);
+		int rejected = V::maskBits(V::maskAnd(scrubbed, V::unsignedLessThan(lowProduct, rejection)));
+		if(rejected) {
+			// Rare biased draws; redo those lanes the way the scalar kernel does
+			uint32_t magnitudes[V::LANES];
+			uint32_t words[V::LANES];
+			V::store((int32_t *) magnitudes, magnitude);
+			V::store((int32_t *) words, counter[2]);
+			for(unsigned lane = 0; lane < V::LANES; lane++) {
+				if(rejected & (1 << lane)) {
+					magnitudes[lane] = region->base + random->bounded(region->range, words[lane], sampleNumber + lane, channel);
+				}
+			}
+			magnitude = V::load((const int32_t *) magnitudes);
+		}
+		Mask negative = V::equal(V::bitAnd(counter[1], one), one);
+		Vector offset = V::blend(constant, V::blend(magnitude, V::sub(zero, magnitude), negative), scrubbed);
+		Vector sample = V::add(V::load(in + i), offset);
+		V::store(out + i, V::min(V::max(sample, minValue), maxValue));
+	}
+	if(i < count) {
+		scrubKernelScalar(parameters, region, in + i, out + i, count - i, firstSample + i, channel);
+	}
+}
+
+}
+
+#endif // SCRUBKERNELSIMD_H
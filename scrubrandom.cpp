@@ -0,0 +1,92 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <random>
+#include "scrubrandom.h"
+
+ScrubRandom::ScrubRandom(uint64_t seed) {
+	this->seed(seed);
+}
+
+void ScrubRandom::seed(uint64_t seed) {
+	aKey[0] = (uint32_t) seed;
+	aKey[1] = (uint32_t) (seed >> 32);
+}
+
+void ScrubRandom::generate(uint64_t sampleNumber, uint32_t channel, uint32_t round, uint32_t words[4]) const {
+	uint32_t counter[4] = {(uint32_t) sampleNumber, (uint32_t) (sampleNumber >> 32), channel, round};
+	uint32_t key[2] = {aKey[0], aKey[1]};
+	for(int i = 0; i < SCRUBRANDOM_PHILOX_ROUNDS; i++) {
+		uint64_t product0 = (uint64_t) SCRUBRANDOM_PHILOX_M0 * counter[0];
+		uint64_t product1 = (uint64_t) SCRUBRANDOM_PHILOX_M1 * counter[2];
+		uint32_t next[4] = {
+			(uint32_t) (product1 >> 32) ^ counter[1] ^ key[0],
+			(uint32_t) product1,
+			(uint32_t) (product0 >> 32) ^ counter[3] ^ key[1],
+			(uint32_t) product0
+		};
+		for(int word = 0; word < 4; word++) {
+			counter[word] = next[word];
+		}
+		key[0] += SCRUBRANDOM_PHILOX_W0;
+		key[1] += SCRUBRANDOM_PHILOX_W1;
+	}
+	for(int word = 0; word < 4; word++) {
+		words[word] = counter[word];
+	}
+}
+
+uint32_t ScrubRandom::bounded(uint32_t range, uint32_t word, uint64_t sampleNumber, uint32_t channel) const {
+	// Lemire's multiply-and-shift
+	uint64_t product = (uint64_t) word * range;
+	uint32_t low = (uint32_t) product;
+	if(low < range) {
+		uint32_t threshold = -range % range;
+		uint32_t round = 1;
+		while(low < threshold) {
+			uint32_t words[4];
+			generate(sampleNumber, channel, round++, words);
+			product = (uint64_t) words[0] * range;
+			low = (uint32_t) product;
+		}
+	}
+	return (uint32_t) (product >> 32);
+}
+
+float ScrubRandom::toFloat(uint32_t word) {
+	return (float) (word >> 8) * (1.f / 16777216.f);
+}
+
+uint32_t ScrubRandom::getKey(int index) const {
+	return aKey[index];
+}
+
+uint64_t ScrubRandom::randomSeed() {
+	std::random_device device;
+	return ((uint64_t) device() << 32) ^ device();
+}
@@ -0,0 +1,62 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef SCRUBRANDOM_H
+#define SCRUBRANDOM_H
+
+#include <stdint.h>
+
+// Philox constants, also used by the vectorized scrub kernels
+#define SCRUBRANDOM_PHILOX_M0 0xD2511F53
+#define SCRUBRANDOM_PHILOX_M1 0xCD9E8D57
+#define SCRUBRANDOM_PHILOX_W0 0x9E3779B9
+#define SCRUBRANDOM_PHILOX_W1 0xBB67AE85
+#define SCRUBRANDOM_PHILOX_ROUNDS 10
+
+// Counter-based pseudo-random generator (Philox4x32-10) keyed by a seed.
+// The random words used for a given sample are a pure function of (seed, sample number, channel),
+// so scrubbing a file serially, in parallel segments or from the middle gives bit-identical results.
+class ScrubRandom
+{
+	public:
+		ScrubRandom(uint64_t seed = 0);
+		void seed(uint64_t seed);
+		// Four random words for the given counter; round selects further independent words for the same sample
+		void generate(uint64_t sampleNumber, uint32_t channel, uint32_t round, uint32_t words[4]) const;
+		// Uniform in [0, range) from the given random word, without modulo bias.
+		// In the rare biased cases, more words are drawn from further rounds of the same counter.
+		uint32_t bounded(uint32_t range, uint32_t word, uint64_t sampleNumber, uint32_t channel) const;
+		// Uniform in [0, 1)
+		static float toFloat(uint32_t word);
+		uint32_t getKey(int index) const;
+		static uint64_t randomSeed();
+	private:
+		uint32_t aKey[2];
+};
+
+#endif // SCRUBRANDOM_H
@@ -0,0 +1,101 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <iostream>
+#include <algorithm>
+#include <mutex>
+#include "scrubreporter.h"
+
+static std::mutex errorOutputMutex;
+
+ScrubReporter::ScrubReporter(std::string file) : aFile(file) {
+}
+
+void ScrubReporter::error(std::string errorMessage, const std::vector<std::string> & details) {
+	aError = errorMessage;
+	std::lock_guard<std::mutex> lock(errorOutputMutex);
+	std::cerr << "\n";
+	std::cerr << " *****************\n";
+	std::cerr << " * File: " << aFile << "\n";
+	std::cerr << " * Error message: " << aError << "\n";
+	for(std::vector<std::string>::const_iterator it = details.begin(); it != details.end(); it++) {
+		std::cerr << " * " << *it << "\n";
+	}
+	std::cerr << " *****************" << std::endl;
+}
+
+bool ScrubReporter::hasError() {
+	return !aError.empty();
+}
+
+void ScrubReporter::setShowProgress(bool showProgress) {
+	aShowProgress = showProgress;
+}
+
+void ScrubReporter::showProgress(int64_t currentSample, int64_t totalSamples, int sampleRate) {
+	if(!aShowProgress) {
+		return;
+	}
+	if(totalSamples <= 0) {
+		if(sampleRate <= 0) {
+			return;
+		}
+		// Nothing to show a percentage of, so count samples instead, once per second of audio
+		int64_t second = currentSample / sampleRate;
+		if(second != aLastProgressSecond) {
+			aLastProgressSecond = second;
+			std::cerr << "\r[" << currentSample << " samples]";
+			std::cerr.flush();
+		}
+		return;
+	}
+	int percentage = (int) (100.d * (double) currentSample / (double) totalSamples);
+	if(percentage != aLastPercentage) {
+		aLastPercentage = percentage;
+		int numEqualSigns = (int) ((double) SCRUBREPORTER_PROGRESS_BAR_LENGTH * (double) currentSample / (double) totalSamples);
+		std::cerr << "\r[";
+		for(int i = 0; i < numEqualSigns; i++) {
+			std::cerr << "=";
+		}
+		for(int i = numEqualSigns; i < SCRUBREPORTER_PROGRESS_BAR_LENGTH; i++) {
+			std::cerr << " ";
+		}
+		std::cerr << "] " << percentage << "% (" << currentSample << "/" << totalSamples << " samples)";
+		if(percentage == 100) {
+			std::cerr << " Done" << std::endl;
+		}
+		std::cerr.flush();
+	}
+}
+
+void ScrubReporter::finishProgress(int64_t totalSamples) {
+	showProgress(totalSamples, totalSamples, 0);
+	if(aShowProgress) {
+		std::cerr << std::endl;
+	}
+}
@@ -0,0 +1,61 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef SCRUBREPORTER_H
+#define SCRUBREPORTER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define SCRUBREPORTER_PROGRESS_BAR_LENGTH 40
+
+// Reports on standard error how the scrubbing of one file goes: a progress bar, if asked for, and the
+// errors met along the way, remembering that there was one. Several files may be scrubbed concurrently;
+// error reports of all of them go through one lock, so they never interleave.
+class ScrubReporter
+{
+	public:
+		ScrubReporter(std::string file);
+		// Each of details is printed on a line of its own below the message, such as the state of a codec
+		void error(std::string errorMessage, const std::vector<std::string> & details = std::vector<std::string>());
+		bool hasError();
+		void setShowProgress(bool showProgress);
+		// Without a total, counts samples once per second of audio instead, if sampleRate is known
+		void showProgress(int64_t currentSample, int64_t totalSamples, int sampleRate);
+		// Fills the progress bar, and leaves it behind
+		void finishProgress(int64_t totalSamples);
+	private:
+		std::string aFile;
+		std::string aError;
+		bool aShowProgress = false;
+		int aLastPercentage = -1;
+		int64_t aLastProgressSecond = -1;
+};
+
+#endif // SCRUBREPORTER_H
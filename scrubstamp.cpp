@@ -0,0 +1,102 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <stdint.h>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include "scrubstamp.h"
+
+// "fLaC", then the STREAMINFO block header, then STREAMINFO up to the end of its MD5 signature
+#define SCRUBSTAMP_HEADER_LENGTH 42
+#define SCRUBSTAMP_MD5_OFFSET 26
+
+static std::string toHex(const unsigned char * bytes, size_t length) {
+	static const char digits[] = "0123456789abcdef";
+	std::string hex;
+	for(size_t i = 0; i < length; i++) {
+		hex.push_back(digits[bytes[i] >> 4]);
+		hex.push_back(digits[bytes[i] & 0xf]);
+	}
+	return hex;
+}
+
+ScrubStamp::ScrubStamp(std::string parameters) {
+	// FNV-1a, which is plenty to tell parameter sets apart and keeps the attribute short
+	uint64_t hash = 14695981039346656037ull;
+	for(std::string::iterator it = parameters.begin(); it != parameters.end(); it++) {
+		hash = (hash ^ (unsigned char) *it) * 1099511628211ull;
+	}
+	unsigned char bytes[8];
+	for(int i = 0; i < 8; i++) {
+		bytes[i] = (unsigned char) (hash >> (56 - 8 * i));
+	}
+	aParameters = toHex(bytes, 8);
+}
+
+bool ScrubStamp::matches(std::string file) {
+	char value[128];
+	ssize_t length = getxattr(file.c_str(), SCRUBSTAMP_ATTRIBUTE, value, sizeof(value));
+	if(length <= 0) {
+		return false;
+	}
+	std::string stamp;
+	return getStamp(file, stamp) && stamp == std::string(value, length);
+}
+
+bool ScrubStamp::write(std::string file) {
+	std::string stamp;
+	if(!getStamp(file, stamp)) {
+		return false;
+	}
+	return setxattr(file.c_str(), SCRUBSTAMP_ATTRIBUTE, stamp.data(), stamp.size(), 0) == 0;
+}
+
+bool ScrubStamp::getStamp(std::string file, std::string & stamp) {
+	int descriptor = open(file.c_str(), O_RDONLY);
+	if(descriptor == -1) {
+		return false;
+	}
+	unsigned char header[SCRUBSTAMP_HEADER_LENGTH];
+	ssize_t length = pread(descriptor, header, sizeof(header), 0);
+	// The attribute stays with the inode, so it outlives tag edits in place and copies over the file,
+	// neither of which changes the audio; its size and modification time do change
+	struct stat status;
+	bool statusRead = fstat(descriptor, &status) == 0;
+	close(descriptor);
+	// STREAMINFO is always the first metadata block
+	if(length != sizeof(header) || !statusRead || header[0] != 'f' || header[1] != 'L' || header[2] != 'a' || header[3] != 'C' || (header[4] & 0x7f) != 0) {
+		return false;
+	}
+	std::ostringstream identity;
+	identity << " " << status.st_size << " " << status.st_mtim.tv_sec << "." << status.st_mtim.tv_nsec;
+	stamp = SCRUBSTAMP_VERSION " " + aParameters + " " + toHex(header + SCRUBSTAMP_MD5_OFFSET, 16) + identity.str();
+	return true;
+}
@@ -0,0 +1,53 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef SCRUBSTAMP_H
+#define SCRUBSTAMP_H
+
+#include <string>
+
+#define SCRUBSTAMP_ATTRIBUTE "user.ascrubber"
+#define SCRUBSTAMP_VERSION "2"
+
+// Marks a scrubbed file with an extended attribute recording how it was scrubbed, the MD5 signature
+// in its STREAMINFO block, and its size and modification time, so that a later run with the same parameters
+// can tell from the header alone that the file has not changed since. Files whose file system has no user
+// attributes simply never match.
+class ScrubStamp
+{
+	public:
+		// parameters describes everything that affects the scrubbed output
+		ScrubStamp(std::string parameters);
+		bool matches(std::string file);
+		bool write(std::string file);
+	private:
+		std::string aParameters; // Hash of the parameters, in hexadecimal
+		bool getStamp(std::string file, std::string & stamp);
+};
+
+#endif // SCRUBSTAMP_H
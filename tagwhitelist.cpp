@@ -0,0 +1,100 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <sstream>
+#include "tagwhitelist.h"
+
+static inline char toLowerAscii(char c) {
+	return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+TagWhitelist::TagWhitelist() {
+}
+
+void TagWhitelist::assign(const std::vector<std::string> & names) {
+	// Keep the table at most half full, so that lookups of names that are not there stop early
+	size_t size = 16;
+	while(size < names.size() * 2) {
+		size *= 2;
+	}
+	aSlots.assign(size, std::string());
+	aMask = size - 1;
+	for(std::vector<std::string>::const_iterator it = names.begin(); it != names.end(); it++) {
+		if(it->empty()) {
+			continue;
+		}
+		std::string name(*it);
+		for(std::string::iterator c = name.begin(); c != name.end(); c++) {
+			*c = toLowerAscii(*c);
+		}
+		size_t slot = hash(name.data(), name.size()) & aMask;
+		while(!aSlots[slot].empty() && aSlots[slot] != name) {
+			slot = (slot + 1) & aMask;
+		}
+		aSlots[slot] = name;
+	}
+}
+
+std::vector<std::string> TagWhitelist::split(std::string list) {
+	std::vector<std::string> names;
+	std::stringstream listStream(list);
+	std::string name;
+	while(std::getline(listStream, name, ',')) {
+		names.push_back(name);
+	}
+	return names;
+}
+
+bool TagWhitelist::contains(const char * name, size_t length) const {
+	if(aSlots.empty() || length == 0) {
+		return false;
+	}
+	for(size_t slot = hash(name, length) & aMask; !aSlots[slot].empty(); slot = (slot + 1) & aMask) {
+		const std::string & candidate = aSlots[slot];
+		if(candidate.size() != length) {
+			continue;
+		}
+		size_t i = 0;
+		while(i < length && toLowerAscii(name[i]) == candidate[i]) {
+			i++;
+		}
+		if(i == length) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// FNV-1a over the lowercased bytes
+uint32_t TagWhitelist::hash(const char * name, size_t length) {
+	uint32_t hash = 2166136261u;
+	for(size_t i = 0; i < length; i++) {
+		hash = (hash ^ (uint8_t) toLowerAscii(name[i])) * 16777619u;
+	}
+	return hash;
+}
@@ -0,0 +1,218 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <algorithm>
+#include <string.h>
+#include "wavscrubber.h"
+
+#define WAVSCRUBBER_DS64 PCMFILESCRUBBER_ID('d', 's', '6', '4')
+#define WAVSCRUBBER_FMT PCMFILESCRUBBER_ID('f', 'm', 't', ' ')
+#define WAVSCRUBBER_FACT PCMFILESCRUBBER_ID('f', 'a', 'c', 't')
+#define WAVSCRUBBER_DATA PCMFILESCRUBBER_ID('d', 'a', 't', 'a')
+#define WAVSCRUBBER_LIST PCMFILESCRUBBER_ID('L', 'I', 'S', 'T')
+#define WAVSCRUBBER_INFO PCMFILESCRUBBER_ID('I', 'N', 'F', 'O')
+#define WAVSCRUBBER_FORMAT_PCM 1
+#define WAVSCRUBBER_FORMAT_EXTENSIBLE 0xfffe
+// Size of an RF64 chunk whose actual size is in the ds64 chunk
+#define WAVSCRUBBER_RF64_SIZE 0xffffffffu
+// RIFF size, data size and sample count, then an empty table of other chunk sizes
+#define WAVSCRUBBER_DS64_SIZE 28
+
+// INFO fields that have a Vorbis comment counterpart; they are kept when it is whitelisted, the others never are
+static const struct {
+	uint32_t id;
+	const char * tag;
+} infoTags[] = {
+	{PCMFILESCRUBBER_ID('I', 'N', 'A', 'M'), "title"},
+	{PCMFILESCRUBBER_ID('I', 'A', 'R', 'T'), "artist"},
+	{PCMFILESCRUBBER_ID('I', 'P', 'R', 'D'), "album"},
+	{PCMFILESCRUBBER_ID('I', 'C', 'R', 'D'), "date"},
+	{PCMFILESCRUBBER_ID('I', 'T', 'R', 'K'), "tracknumber"},
+	{PCMFILESCRUBBER_ID('I', 'P', 'R', 'T'), "tracknumber"},
+	{PCMFILESCRUBBER_ID('I', 'G', 'N', 'R'), "genre"},
+	{PCMFILESCRUBBER_ID('I', 'C', 'M', 'T'), "comment"},
+	{PCMFILESCRUBBER_ID('I', 'C', 'O', 'P'), "copyright"},
+	{PCMFILESCRUBBER_ID('I', 'S', 'B', 'J'), "subject"},
+	{PCMFILESCRUBBER_ID('I', 'S', 'F', 'T'), "encoder"}
+};
+
+WAVScrubber::WAVScrubber(std::string file) : PCMFileScrubber(file) {
+}
+
+bool WAVScrubber::parse() {
+	const uint8_t * data = aMappedFile.data();
+	uint64_t size = aMappedFile.size();
+	uint32_t id = size >= 12 ? readLE32(data) : 0;
+	error((id == WAVSCRUBBER_RIFF || id == WAVSCRUBBER_RF64) && readLE32(data + 8) == WAVSCRUBBER_WAVE, "Not a WAV file.");
+	if(hasError()) {
+		return false;
+	}
+	aRF64 = id == WAVSCRUBBER_RF64;
+	// Anything past the RIFF chunk is not part of the file; some writers leave its size at 0 though
+	uint64_t end = size;
+	if(!aRF64 && readLE32(data + 4) >= 4) {
+		end = std::min(size, 8 + (uint64_t) readLE32(data + 4));
+	}
+	uint64_t dataSize = 0;
+	bool hasDs64 = false;
+	bool hasFormat = false;
+	bool hasData = false;
+	for(uint64_t offset = 12; offset + 8 <= end; ) {
+		Chunk chunk;
+		chunk.id = readLE32(data + offset);
+		chunk.size = readLE32(data + offset + 4);
+		chunk.offset = offset + 8;
+		if(aRF64 && chunk.id == WAVSCRUBBER_DS64 && chunk.size >= WAVSCRUBBER_DS64_SIZE && !hasDs64) {
+			const uint8_t * body = data + chunk.offset;
+			if(readLE64(body) >= 4) {
+				end = std::min(size, 8 + readLE64(body));
+			}
+			dataSize = readLE64(body + 8);
+			aSampleCount = readLE64(body + 16);
+			hasDs64 = true;
+		} else if(hasDs64 && chunk.id == WAVSCRUBBER_DATA && chunk.size == WAVSCRUBBER_RF64_SIZE) {
+			chunk.size = dataSize;
+		}
+		error(chunk.offset + chunk.size <= end, "The file is truncated.");
+		if(hasError()) {
+			return false;
+		}
+		if(chunk.id == WAVSCRUBBER_FMT && !hasFormat) {
+			if(!parseFormat(chunk)) {
+				return false;
+			}
+			aFormatChunk = aChunks.size();
+			hasFormat = true;
+		} else if(chunk.id == WAVSCRUBBER_DATA) {
+			error(hasFormat && !hasData, hasData ? "More than one data chunk." : "Data chunk before the format chunk.");
+			if(hasError()) {
+				return false;
+			}
+			aSamplesChunk = aChunks.size();
+			aSamplesOffset = chunk.offset;
+			aSamplesSize = chunk.size;
+			hasData = true;
+		}
+		aChunks.push_back(chunk);
+		offset = chunk.offset + chunk.size + (chunk.size & 1);
+	}
+	error(!aRF64 || hasDs64, "RF64 file without a ds64 chunk.");
+	error(hasData, "No data chunk.");
+	return !hasError();
+}
+
+bool WAVScrubber::parseFormat(const Chunk & chunk) {
+	const uint8_t * body = aMappedFile.data() + chunk.offset;
+	error(chunk.size >= 16, "Format chunk too short.");
+	if(hasError()) {
+		return false;
+	}
+	unsigned format = readLE16(body);
+	aNumChannels = readLE16(body + 2);
+	unsigned blockAlign = readLE16(body + 12);
+	unsigned bits = readLE16(body + 14);
+	unsigned validBits = bits;
+	if(format == WAVSCRUBBER_FORMAT_EXTENSIBLE) {
+		error(chunk.size >= 40 && readLE16(body + 16) >= 22, "Extensible format chunk too short.");
+		if(hasError()) {
+			return false;
+		}
+		validBits = readLE16(body + 18);
+		// The sub-format GUID starts with the format code
+		format = readLE16(body + 24);
+	}
+	// Samples sit in the top bits of little-endian containers, signed except for 8 bits
+	aLayout.bytesPerSample = bits / 8;
+	aLayout.bitsPerSample = validBits;
+	aLayout.bigEndian = false;
+	aLayout.isUnsigned = aLayout.bytesPerSample == 1;
+	error(format == WAVSCRUBBER_FORMAT_PCM, "Only integer PCM WAV files are supported.");
+	error(bits % 8 == 0 && PCMCodec::isSupported(aLayout) && aNumChannels > 0 && blockAlign == aNumChannels * aLayout.bytesPerSample, "Unsupported sample format.");
+	return !hasError();
+}
+
+bool WAVScrubber::rebuildChunk(size_t index, uint64_t fileSize, std::vector<uint8_t> & body) {
+	const Chunk & chunk = aChunks[index];
+	const uint8_t * data = aMappedFile.data() + chunk.offset;
+	if(chunk.id == WAVSCRUBBER_DS64) {
+		appendLE64(body, fileSize - 8);
+		appendLE64(body, aSamplesSize);
+		appendLE64(body, aSampleCount);
+		appendLE32(body, 0);
+		return true;
+	}
+	if((chunk.id == WAVSCRUBBER_FMT && index == aFormatChunk) || chunk.id == WAVSCRUBBER_FACT) {
+		body.assign(data, data + chunk.size);
+		return true;
+	}
+	if(chunk.id == WAVSCRUBBER_LIST) {
+		return filterInfo(chunk, body);
+	}
+	// The samples follow the chunk header right away
+	return index == aSamplesChunk;
+}
+
+void WAVScrubber::appendFileHeader(std::vector<uint8_t> & out, uint64_t fileSize) {
+	appendLE32(out, aRF64 ? WAVSCRUBBER_RF64 : WAVSCRUBBER_RIFF);
+	appendLE32(out, aRF64 ? WAVSCRUBBER_RF64_SIZE : (uint32_t) (fileSize - 8));
+	appendLE32(out, WAVSCRUBBER_WAVE);
+}
+
+void WAVScrubber::appendChunkHeader(std::vector<uint8_t> & out, uint32_t id, uint64_t size) {
+	appendLE32(out, id);
+	appendLE32(out, aRF64 && id == WAVSCRUBBER_DATA ? WAVSCRUBBER_RF64_SIZE : (uint32_t) size);
+}
+
+bool WAVScrubber::filterInfo(const Chunk & chunk, std::vector<uint8_t> & body) {
+	const uint8_t * data = aMappedFile.data() + chunk.offset;
+	// Other lists, such as cue point labels, are dropped altogether
+	if(chunk.size < 4 || readLE32(data) != WAVSCRUBBER_INFO) {
+		return false;
+	}
+	appendLE32(body, WAVSCRUBBER_INFO);
+	for(uint64_t offset = 4; offset + 8 <= chunk.size; ) {
+		uint32_t id = readLE32(data + offset);
+		uint64_t size = readLE32(data + offset + 4);
+		uint64_t next = offset + 8 + size + (size & 1);
+		if(offset + 8 + size > chunk.size) {
+			break;
+		}
+		for(size_t i = 0; i < sizeof(infoTags) / sizeof(infoTags[0]); i++) {
+			if(infoTags[i].id == id && aAllowedTags.contains(infoTags[i].tag, strlen(infoTags[i].tag))) {
+				body.insert(body.end(), data + offset, data + offset + 8 + size);
+				if(size & 1) {
+					body.push_back(0);
+				}
+				break;
+			}
+		}
+		offset = next;
+	}
+	// Nothing left worth a chunk
+	return body.size() > 4;
+}
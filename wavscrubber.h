@@ -0,0 +1,61 @@
+/*
+    Copyright (c) 2012, Etienne Perot <etienne@perot.me>
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+        * Redistributions of source code must retain the above copyright
+        notice, this list of conditions and the following disclaimer.
+        * Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+        * Neither the name of the <organization> nor the
+        names of its contributors may be used to endorse or promote products
+        derived from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY <copyright holder> <email> ''AS IS'' AND ANY
+    EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL <copyright holder> <email> BE LIABLE FOR ANY
+    DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef WAVSCRUBBER_H
+#define WAVSCRUBBER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "pcmfilescrubber.h"
+
+#define WAVSCRUBBER_RIFF PCMFILESCRUBBER_ID('R', 'I', 'F', 'F')
+#define WAVSCRUBBER_RF64 PCMFILESCRUBBER_ID('R', 'F', '6', '4')
+#define WAVSCRUBBER_WAVE PCMFILESCRUBBER_ID('W', 'A', 'V', 'E')
+
+// PCM WAV and RF64 files. Only the chunks needed to play the file are kept: the format, fact and data
+// chunks, and a LIST/INFO chunk reduced to the whitelisted tags. Everything else (bext, iXML, cue
+// points, other LIST chunks, padding...) is dropped.
+class WAVScrubber : public PCMFileScrubber
+{
+	public:
+		WAVScrubber(std::string file);
+	protected:
+		bool parse();
+		bool rebuildChunk(size_t index, uint64_t fileSize, std::vector<uint8_t> & body);
+		void appendFileHeader(std::vector<uint8_t> & out, uint64_t fileSize);
+		void appendChunkHeader(std::vector<uint8_t> & out, uint32_t id, uint64_t size);
+	private:
+		bool aRF64 = false;
+		size_t aFormatChunk = 0;
+		uint64_t aSampleCount = 0; // From the ds64 chunk of RF64 files
+		bool parseFormat(const Chunk & chunk);
+		bool filterInfo(const Chunk & chunk, std::vector<uint8_t> & body);
+};
+
+#endif // WAVSCRUBBER_H